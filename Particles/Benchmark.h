@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Small timing helpers shared by the benchmark programs.
+namespace Benchmark
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Seconds elapsed since start
+    inline double secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Keep a computed value alive so the optimizer cannot drop the work behind it
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Nearest-rank percentile (0 to 100) of samples; sorts them in place
+    inline double percentile(std::vector<double>& samples, double p)
+    {
+        if (samples.empty())
+        {
+            return 0.0;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * samples.size() + 0.5);
+        return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    // Calls to operator new so far in this program. Counted by
+    // AllocationCounter.cpp, which replaces the global operator new and
+    // delete; a program that does not link it cannot call this.
+    size_t allocationCount();
+
+    // Bytes asked of operator new so far, counted alongside allocationCount
+    size_t allocatedBytes();
+
+    // Run body repeatedly until at least minSeconds have passed.
+    // Returns the average nanoseconds per call.
+    template <typename F>
+    double nsPerCall(F body, double minSeconds = 0.25)
+    {
+        body(); // Warm caches and branch predictors
+        size_t calls = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            body();
+            calls++;
+            elapsed = secondsSince(start);
+        } while (elapsed < minSeconds);
+        return elapsed * 1e9 / static_cast<double>(calls);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+// Raw binary serialization of plain data, in the host's byte order.
+// Recordings say which byte order they were written in; see Recording.h.
+
+// Appends values to a byte buffer
+class ByteWriter
+{
+public:
+    explicit ByteWriter(vector<char>& out) : m_out(out) {}
+
+    void bytes(const void* data, size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        m_out.insert(m_out.end(), p, p + size);
+    }
+
+    template <typename T>
+    void pod(const T& value)
+    {
+        static_assert(is_trivially_copyable<T>::value, "ByteWriter only writes plain data");
+        bytes(&value, sizeof(T));
+    }
+
+    // Element count, then the elements of v from first on
+    template <typename T>
+    void array(const vector<T>& v, size_t first = 0)
+    {
+        static_assert(is_trivially_copyable<T>::value, "ByteWriter only writes plain data");
+        pod<uint64_t>(v.size() - first);
+        if (v.size() > first)
+        {
+            bytes(v.data() + first, (v.size() - first) * sizeof(T));
+        }
+    }
+
+    size_t size() const { return m_out.size(); }
+
+private:
+    vector<char>& m_out;
+};
+
+// Reads values back from a span of bytes, without copying the span.
+// Every read checks the bounds; after a failed read ok() is false and all
+// further reads fail.
+class ByteReader
+{
+public:
+    ByteReader(const char* data, size_t size) : m_position(data), m_end(data + size), m_ok(true) {}
+
+    bool bytes(void* out, size_t size)
+    {
+        if (!m_ok || static_cast<size_t>(m_end - m_position) < size)
+        {
+            m_ok = false;
+            return false;
+        }
+        memcpy(out, m_position, size);
+        m_position += size;
+        return true;
+    }
+
+    template <typename T>
+    bool pod(T& value)
+    {
+        static_assert(is_trivially_copyable<T>::value, "ByteReader only reads plain data");
+        return bytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    bool array(vector<T>& v)
+    {
+        uint64_t count = 0;
+        if (!pod(count) || count > remaining() / sizeof(T))
+        {
+            m_ok = false;
+            return false;
+        }
+        v.resize(static_cast<size_t>(count));
+        return count == 0 || bytes(v.data(), v.size() * sizeof(T));
+    }
+
+    // Skip size bytes, returning where they start, or null if there are not that many
+    const char* skip(size_t size)
+    {
+        if (!m_ok || static_cast<size_t>(m_end - m_position) < size)
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        const char* start = m_position;
+        m_position += size;
+        return start;
+    }
+
+    bool ok() const { return m_ok; }
+    size_t remaining() const { return static_cast<size_t>(m_end - m_position); }
+    const char* position() const { return m_position; }
+
+private:
+    const char* m_position;
+    const char* m_end;
+    bool m_ok;
+};
@@ -1,11 +1,375 @@
 #include "Engine.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // The engine draws small particles with fewer vertices unless told otherwise
+    LodConfig defaultLod()
+    {
+        LodConfig lod;
+        lod.enabled = true;
+        return lod;
+    }
+}
 
 Engine::Engine()
+    : m_random(Random::kDefaultSeed, kSpawnStream), m_seed(Random::kDefaultSeed),
+      m_updateThreads(1), m_timestep(Timestep::Variable), m_tickSeconds(1.0 / 120.0), m_accumulator(0.0),
+      m_viewportPending(false), m_profiling(false), m_showOverlay(false), m_profileJson(false), m_profileEvery(600),
+      m_profileExported(0)
 {
     // Call create on m_Window to populate the RenderWindow member variable
     // You can assign a custom resolution or you can call VideoMode::getDesktopMode() 
     m_Window.create(VideoMode::getDesktopMode(), "Particles");
-    m_isMousePressed = false; // Initialize the mouse press state
+    m_size = m_Window.getSize();
+    m_cartesianToPixel = cartesianToPixel(m_size);
+    m_particles.setViewport(cartesianViewport(m_size));
+    m_particles.setRetireOffscreen(true);
+    m_particles.setLod(defaultLod());
+    m_input.reset(new MouseInput(m_Window));
+}
+
+Engine::Engine(Vector2u size)
+    : m_random(Random::kDefaultSeed, kSpawnStream), m_seed(Random::kDefaultSeed),
+      m_updateThreads(1), m_timestep(Timestep::Variable), m_tickSeconds(1.0 / 120.0), m_accumulator(0.0),
+      m_viewportPending(false), m_profiling(false), m_showOverlay(false), m_profileJson(false), m_profileEvery(600),
+      m_profileExported(0)
+{
+    // No window: m_Window stays closed and only the simulation runs
+    m_size = size;
+    m_cartesianToPixel = cartesianToPixel(m_size);
+    m_particles.setViewport(cartesianViewport(m_size));
+    m_particles.setRetireOffscreen(true);
+    m_particles.setLod(defaultLod());
+}
+
+void Engine::seed(unsigned seed)
+{
+    m_random.seed(seed, kSpawnStream);
+    m_seed = seed;
+}
+
+void Engine::spawn(Vector2i position, int count, int minPoints, int maxPoints)
+{
+    PROFILE_SCOPE(profiler(), Spawn);
+    if (m_simulation)
+    {
+        m_simulation->requestSpawn(position, count, m_size, minPoints, maxPoints);
+        return;
+    }
+    if (m_recorder)
+    {
+        m_recorder->spawn(position, count, minPoints, maxPoints);
+    }
+    const EmitterConfig emitter = withPointRange(m_emitter, minPoints, maxPoints);
+    for (int i = 0; i < count; i++)
+    {
+        m_particles.spawn(m_size, emitter, position, m_random);
+    }
+}
+
+void Engine::pollInput(float dt)
+{
+    if (!m_input)
+    {
+        return;
+    }
+    // The command list keeps its capacity, so steady input allocates nothing
+    m_commands.clear();
+    m_input->poll(dt, m_commands);
+    m_budget.beginFrame(dt, m_particles.size());
+    for (const SpawnCommand& command : m_commands)
+    {
+        const int count = m_budget.admit(command.count);
+        if (count == 0)
+        {
+            continue;
+        }
+        int minPoints = command.minPoints;
+        int maxPoints = command.maxPoints;
+        m_budget.limitPoints(m_emitter, minPoints, maxPoints);
+        spawn(command.position, count, minPoints, maxPoints);
+    }
+}
+
+void Engine::shedLoad()
+{
+    // A replay could not repeat it, and the simulation thread owns its particles
+    if (m_recorder || m_simulation)
+    {
+        return;
+    }
+    const size_t count = m_budget.shedCount(m_particles.size());
+    if (count > 0)
+    {
+        PROFILE_SCOPE(profiler(), Expiry);
+        m_budget.shed(m_particles.retireOldest(count));
+    }
+}
+
+void Engine::reserve(size_t particles)
+{
+    // Prebuilt shapes take no room in the vertex pool
+    size_t vertices = m_emitter.shapes == ShapeSource::Prebuilt ? 0 : particles * m_emitter.maxPoints;
+    m_particles.reserve(particles, vertices);
+}
+
+void Engine::setTimestep(Timestep mode, double ticksPerSecond)
+{
+    m_timestep = mode;
+    m_tickSeconds = 1.0 / ticksPerSecond;
+    m_accumulator = 0.0;
+}
+
+float Engine::advance(float frameSeconds)
+{
+    switch (m_timestep)
+    {
+    case Timestep::Variable:
+        update(frameSeconds);
+        return 1.0f;
+
+    case Timestep::Fixed:
+    {
+        // Whole ticks of the time accumulated so far; the remainder carries over
+        m_accumulator += frameSeconds;
+        int ticks = 0;
+        while (m_accumulator >= m_tickSeconds)
+        {
+            if (ticks == kMaxTicksPerFrame)
+            {
+                m_accumulator = fmod(m_accumulator, m_tickSeconds);
+                break;
+            }
+            update(static_cast<float>(m_tickSeconds));
+            m_accumulator -= m_tickSeconds;
+            ticks++;
+        }
+        return static_cast<float>(m_accumulator / m_tickSeconds);
+    }
+
+    case Timestep::Threaded:
+        if (!m_simulation)
+        {
+            m_simulation.reset(new Simulation(m_particles, m_random, m_emitter, m_tickSeconds, m_updateThreads));
+            m_simulation->start();
+            m_viewportPending = false;
+        }
+        // Sent again next frame if the queue is full
+        if (m_viewportPending)
+        {
+            m_viewportPending = !m_simulation->requestViewport(m_particles.getViewport());
+        }
+        // Swapping takes the new state without copying it; the old one goes
+        // back to the simulation thread to be overwritten
+        if (m_simulation->acquire())
+        {
+            m_particles.swapState(m_simulation->latest().particles);
+        }
+        return m_simulation->alpha(Simulation::Clock::now());
+    }
+    return 1.0f;
+}
+
+void Engine::step(float dtAsSeconds, bool buildVertices)
+{
+    // A frame without window events or presentation; spawns made since the
+    // last step were not part of a frame and are not counted
+    PROFILE_BEGIN_FRAME(profiler());
+    m_budget.beginWork();
+    {
+        PROFILE_SCOPE(profiler(), Input);
+        pollInput(dtAsSeconds);
+    }
+    float alpha = advance(dtAsSeconds);
+    recordFrame(dtAsSeconds);
+    shedLoad();
+    if (buildVertices)
+    {
+        PROFILE_SCOPE(profiler(), BuildVertices);
+        m_particles.buildStream(alpha);
+    }
+    m_budget.endWork();
+    m_budget.endFrame(m_particles.size());
+    PROFILE_END_FRAME(profiler(), m_particles.size(), m_particles.vertexCount(),
+                      buildVertices ? m_particles.drawnVertices() : 0, buildVertices ? m_particles.lodSkippedVertices() : 0);
+    endProfiledFrame();
+}
+
+void Engine::writeState(ByteWriter& out) const
+{
+    out.pod(m_random.getState());
+    out.pod(m_accumulator);
+    m_particles.writeState(out);
+}
+
+bool Engine::readState(ByteReader& in)
+{
+    Random::State random;
+    double accumulator = 0.0;
+    const bool ok = in.pod(random) && in.pod(accumulator) && m_particles.readState(in);
+    if (ok)
+    {
+        m_random.setState(random);
+        m_accumulator = accumulator;
+    }
+    else
+    {
+        m_particles.clear();
+    }
+    return ok;
+}
+
+bool Engine::startRecording(const string& path, unsigned checksumEvery, unsigned snapshotEvery)
+{
+    stopRecording();
+    if (m_timestep == Timestep::Threaded)
+    {
+        return false;
+    }
+    RecordingHeader header;
+    header.width = m_size.x;
+    header.height = m_size.y;
+    header.seed = m_seed;
+    header.timestep = static_cast<uint8_t>(m_timestep);
+    header.tickSeconds = m_tickSeconds;
+    header.emitter = m_emitter;
+    header.collisions = m_particles.getCollisions();
+    header.retireOffscreen = m_particles.getRetireOffscreen();
+    header.checksumEvery = checksumEvery;
+    header.snapshotEvery = snapshotEvery;
+
+    m_recorder.reset(new RecordingWriter());
+    if (!m_recorder->open(path, header))
+    {
+        m_recorder.reset();
+        return false;
+    }
+    recordSnapshot(0);
+    return true;
+}
+
+void Engine::stopRecording()
+{
+    m_recorder.reset();
+}
+
+void Engine::recordFrame(float dt)
+{
+    if (!m_recorder)
+    {
+        return;
+    }
+    PROFILE_SCOPE(profiler(), Record);
+    const uint64_t frame = m_recorder->endFrame(dt);
+    const RecordingHeader& header = m_recorder->header();
+    if (header.checksumEvery > 0 && frame % header.checksumEvery == 0)
+    {
+        m_recorder->checksum(frame, m_particles.checksum(), m_particles.size());
+    }
+    if (header.snapshotEvery > 0 && frame % header.snapshotEvery == 0)
+    {
+        recordSnapshot(frame);
+    }
+}
+
+void Engine::recordSnapshot(uint64_t frame)
+{
+    ByteWriter out = m_recorder->beginSnapshot(frame, m_particles.checksum());
+    writeState(out);
+    m_recorder->endRecord();
+}
+
+void Engine::rasterize(SoftwareRasterizer& target, float alpha)
+{
+    size_t streamSize;
+    {
+        PROFILE_SCOPE(profiler(), BuildVertices);
+        streamSize = m_particles.buildStream(alpha);
+    }
+    PROFILE_SCOPE(profiler(), Submit);
+    target.resize(m_size.x, m_size.y);
+    target.clear();
+    target.draw(m_particles.getStream(), streamSize, m_cartesianToPixel, m_updatePool.get());
+}
+
+bool Engine::setProfileExport(const string& path, unsigned everyFrames)
+{
+    m_profileOut.close();
+    m_profileOut.clear();
+    m_profileOut.open(path.c_str());
+    if (!m_profileOut)
+    {
+        return false;
+    }
+    m_profileJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    m_profileEvery = max(1u, min(everyFrames, static_cast<unsigned>(FrameProfiler::kFrames)));
+    m_profileExported = m_profiler.frameCount();
+    if (!m_profileJson)
+    {
+        FrameProfiler::writeCsvHeader(m_profileOut);
+    }
+    m_profiling = true;
+    return true;
+}
+
+void Engine::endProfiledFrame()
+{
+    if (!m_profiling)
+    {
+        return;
+    }
+    const uint64_t frames = m_profiler.frameCount();
+
+    // The overlay text, or the title when there is no font, twice a second
+    if (m_showOverlay && frames % 30 == 0)
+    {
+        if (m_overlay.hasFont())
+        {
+            m_overlay.refresh(m_profiler, m_budget.enabled() ? m_budget.summary() : string());
+        }
+        else if (m_Window.isOpen())
+        {
+            FrameProfiler::Stats frame = m_profiler.stats(FrameProfiler::kPhaseCount, 120);
+            ostringstream title;
+            title << fixed << setprecision(2) << "Particles - " << m_profiler.lastParticles() << " particles, frame ms p50 "
+                  << frame.p50 << " p99 " << frame.p99 << " max " << frame.max;
+            if (m_budget.enabled())
+            {
+                title << ", " << m_budget.summary();
+            }
+            m_Window.setTitle(title.str());
+        }
+    }
+
+    if (m_profileOut.is_open() && frames - m_profileExported >= m_profileEvery)
+    {
+        if (m_profileJson)
+        {
+            m_profiler.writeJson(m_profileOut, static_cast<size_t>(frames - m_profileExported));
+        }
+        else
+        {
+            m_profiler.writeCsv(m_profileOut, m_profileExported);
+        }
+        m_profileOut.flush();
+        m_profileExported = frames;
+    }
+}
+
+void Engine::setUpdateThreads(unsigned threads)
+{
+    m_updateThreads = threads;
+    if (threads == 1)
+    {
+        m_updatePool.reset();
+    }
+    else
+    {
+        m_updatePool.reset(new ThreadPool(threads));
+    }
 }
 
 void Engine::run()
@@ -32,18 +396,31 @@ void Engine::run()
         // Convert the clock time to seconds
         float dtAsSeconds = dt.asSeconds();
 
+        PROFILE_BEGIN_FRAME(profiler());
+        m_budget.beginWork();
+
         // Call input
-        input();
+        {
+            PROFILE_SCOPE(profiler(), Input);
+            input(dtAsSeconds);
+        }
 
         // Call update
-        update(dtAsSeconds);
+        float alpha = advance(dtAsSeconds);
+        recordFrame(dtAsSeconds);
+        shedLoad();
 
         // Call draw
-        draw();
+        draw(alpha);
+        m_budget.endFrame(m_particles.size());
+
+        PROFILE_END_FRAME(profiler(), m_particles.size(), m_particles.vertexCount(),
+                          m_particles.drawnVertices(), m_particles.lodSkippedVertices());
+        endProfiledFrame();
     }
 }
 
-void Engine::input()
+void Engine::input(float dt)
 {
     // Poll the Windows event queue
     Event event;
@@ -56,88 +433,92 @@ void Engine::input()
             {
                 m_Window.close();
             }
-        }
-        if (event.type == Event::Closed)
-        {
-            m_Window.close();
-        }
 
-        // Handle the left mouse button pressed event
-        if (event.type == Event::MouseButtonPressed)
-        {
-            if (event.mouseButton.button == Mouse::Left)
+            // F3 shows or hides the profiler overlay, profiling from then on
+            if (event.key.code == Keyboard::F3)
             {
-                m_isMousePressed = true; // Set the flag to true when the mouse button is pressed
-                // Create particles at the initial mouse press position
-                for (int i = 0; i < 5; i++)
+                m_showOverlay = !m_showOverlay;
+                if (m_showOverlay)
                 {
-                    int numPoints = rand() % 26 + 25;
-                    m_particles.push_back(Particle(m_Window, numPoints, Mouse::getPosition(m_Window)));
+                    m_profiling = true;
+                    if (!m_overlay.hasFont())
+                    {
+                        m_overlay.loadFont();
+                    }
+                }
+                else
+                {
+                    m_Window.setTitle("Particles");
                 }
             }
         }
+        if (event.type == Event::Closed)
+        {
+            m_Window.close();
+        }
 
-        // Handle the left mouse button released event
-        if (event.type == Event::MouseButtonReleased)
+        // Keep one pixel per unit when the window is resized
+        if (event.type == Event::Resized)
         {
-            if (event.mouseButton.button == Mouse::Left)
-            {
-                m_isMousePressed = false; // Set the flag to false when the mouse button is released
-            }
+            m_Window.setView(View(FloatRect(0.f, 0.f, static_cast<float>(event.size.width), static_cast<float>(event.size.height))));
+            m_size = m_Window.getSize();
+            m_cartesianToPixel = cartesianToPixel(m_size);
+            m_particles.setViewport(cartesianViewport(m_size));
+            m_viewportPending = true;
         }
-    }
 
-    // Create particles while the left mouse button is held down
-    if (m_isMousePressed)
-    {
-        for (int i = 0; i < 5; i++)
+        // Mouse buttons and the like are the input source's business
+        if (m_input)
         {
-            int numPoints = rand() % 26 + 25;
-            m_particles.push_back(Particle(m_Window, numPoints, Mouse::getPosition(m_Window)));
+            m_input->handleEvent(event);
         }
     }
+
+    // Create the particles the input source asks for in this frame
+    pollInput(dt);
 }
 
 void Engine::update(float dtAsSeconds)
 {
-    // The general idea here is to loop through m_particles and call update on each Particle in the vector 
-    // whose ttl (time to live) has not expired
-    // If a particle's ttl has expired, it must be erased from the vector
-    // This is best done with an iterator-based for-loop
-    // Don't automatically increment the iterator for each iteration
-    for (auto it = m_particles.begin(); it != m_particles.end(); )
+    // Update every live particle and drop the ones whose ttl (time to live) has expired
+    // The store compacts itself in a single pass, so no per-element erase is needed
     {
-        if (it->getTTL() > 0.0)
-        {
-            // Call update on that Particle
-            // Pass in the time differential since the last frame (dt)
-            it->update(dtAsSeconds);
-            // increment the iterator
-            ++it;
-        }
-        else
-        {
-            // erase the element the iterator points to
-            it = m_particles.erase(it);
-            // erase returns an iterator that points to the next element after deletion, or end if it is the end of the vector
-            // Assign the iterator to this return value
-            // Do not increment the iterator (if you do you might increment past the end of the vector after you delete the last element)
-        }
+        PROFILE_SCOPE(profiler(), Transform);
+        m_particles.advance(dtAsSeconds, m_updatePool.get());
+    }
+    {
+        PROFILE_SCOPE(profiler(), Expiry);
+        m_particles.retireExpired();
     }
 }
 
-void Engine::draw()
+void Engine::draw(float alpha)
 {
     // Clear the last frame
     m_Window.clear();
 
-    // Draw all the particles
-    for (auto const& particle : m_particles)
+    // Draw all the particles, mapped to pixels by one transform for the whole system
+    size_t streamSize;
     {
-        m_Window.draw(particle);
+        PROFILE_SCOPE(profiler(), BuildVertices);
+        streamSize = m_particles.buildStream(alpha);
     }
+    {
+        PROFILE_SCOPE(profiler(), Submit);
+        m_particles.submit(m_Window, RenderStates(m_cartesianToPixel), streamSize);
+        if (m_showOverlay)
+        {
+            m_Window.draw(m_overlay);
+        }
+    }
+
+    // Waiting for the display is not work the budget can cut
+    m_budget.endWork();
 
     // End the current frame and display its contents on screen
-    m_Window.display();
+    {
+        PROFILE_SCOPE(profiler(), Present);
+        m_Window.display();
+    }
 }
 
@@ -1,31 +1,227 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include "FrameBudget.h"
+#include "InputSource.h"
 #include "Particle.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "Recording.h"
+#include "Simulation.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include <fstream>
+#include <memory>
+#include <string>
 using namespace sf;
 using namespace std;
 
+// How the engine steps the simulation
+enum class Timestep
+{
+    Variable, // One update per frame by the frame's duration
+    Fixed,    // Fixed ticks on the main thread, drawn interpolated
+    Threaded  // Fixed ticks on a simulation thread, drawn interpolated
+};
+
 class Engine
 {
 private:
-    // The main game window
+    // Stream of the run seed that spawning draws from
+    static const uint64_t kSpawnStream = 1;
+
+    // The main game window, not created in headless mode
     RenderWindow m_Window;
 
-    // Collection of particles
-    vector<Particle> m_particles;
-    bool m_isMousePressed; // Tracks if the mouse button is pressed
+    // Size in pixels of the area particles live in: the window, or the
+    // simulated screen of a headless engine
+    Vector2u m_size;
+
+    // Maps particle coordinates to window pixels, updated when the window is resized
+    Transform m_cartesianToPixel;
+
+    // Collection of particles, stored as contiguous arrays
+    ParticleSystem m_particles;
+
+    // Where spawns come from, if anywhere, and the spawns of the frame
+    unique_ptr<InputSource> m_input;
+    vector<SpawnCommand> m_commands;
+
+    // Generator for spawning: one stream of the run seed
+    Random m_random;
+    uint64_t m_seed;
+
+    // How the mouse emitter shapes its particles
+    EmitterConfig m_emitter;
+
+    // Workers for the parallel update and rasterizing, null when updating on
+    // the main thread. The simulation thread makes its own, m_updateThreads of them.
+    unique_ptr<ThreadPool> m_updatePool;
+    unsigned m_updateThreads;
+
+    // Fixed timesteps: the tick, and frame time not simulated yet
+    static const int kMaxTicksPerFrame = 5; // Beyond this a slow frame's time is dropped
+    Timestep m_timestep;
+    double m_tickSeconds;
+    double m_accumulator;
+
+    // The simulation thread in Timestep::Threaded, started by the first
+    // advance. m_particles then holds the latest state it published.
+    unique_ptr<Simulation> m_simulation;
+    bool m_viewportPending;               // m_particles' viewport changed and the simulation has yet to get it
+
+    // The session being recorded, if any
+    unique_ptr<RecordingWriter> m_recorder;
+
+    // Frame timings, recorded while m_profiling is set
+    FrameProfiler m_profiler;
+    bool m_profiling;
+    ProfilerOverlay m_overlay;
+    bool m_showOverlay;             // Toggled with F3
+    ofstream m_profileOut;          // Periodic export, when open
+    bool m_profileJson;             // Export summaries as JSON lines instead of CSV rows
+    unsigned m_profileEvery;        // Frames between exports
+    uint64_t m_profileExported;     // First frame not exported yet
+
+    // The profiler to record into, null when not profiling
+    FrameProfiler* profiler() { return m_profiling ? &m_profiler : nullptr; }
+
+    // Finish a profiled frame: overlay text and periodic export
+    void endProfiledFrame();
+
+    // Record the frame just simulated, which lasted dt, when recording
+    void recordFrame(float dt);
+    void recordSnapshot(uint64_t frame);
+
+    // Spawn what the input source asks for in a frame of dt, as far as the
+    // frame-time budget admits it
+    void pollInput(float dt);
+
+    // Adapts spawning to the frame-time budget, when one is set
+    FrameBudget m_budget;
+
+    // Retire the oldest particles the budget says to shed this frame
+    void shedLoad();
 
     // Private methods for game logic
-    void input();          // Handles user input
-    void update(float dtAsSeconds); // Updates game state
-    void draw();           // Renders the scene
+    void input(float dt);  // Handles user input
+    void update(float dtAsSeconds); // Updates game state by one step
+    void draw(float alpha); // Renders the scene, alpha of the way into the last step
 
 public:
     // Engine constructor
     Engine();
 
+    // Headless engine: no window or display, a simulated screen of the given size.
+    // Driven by the caller through spawn() and step() instead of run().
+    explicit Engine(Vector2u size);
+
     // Starts the main game loop
     void run();
 
+    // Seed the random numbers used to spawn particles, for reproducible runs
+    void seed(unsigned seed);
+
+    // Spawn count particles at a pixel position, as a mouse click does, with
+    // vertex counts in [minPoints, maxPoints] or, when 0, the emitter's
+    void spawn(Vector2i position, int count, int minPoints = 0, int maxPoints = 0);
+
+    // Where spawns come from: the mouse for an engine with a window, nothing
+    // for a headless one. Polled every frame by run() and step(); null for none.
+    void setInput(unique_ptr<InputSource> input) { m_input = move(input); }
+    InputSource* getInput() { return m_input.get(); }
+
+    // Hold a frame-time budget (see FrameBudget): as frames stay over it,
+    // spawns from the input source are throttled, then given fewer vertices,
+    // then stopped while the oldest particles are retired. Off by default.
+    // Particles are only retired early with the simulation on the main
+    // thread and no recording running, since a replay could not repeat it.
+    void setBudget(const BudgetConfig& budget) { m_budget.setConfig(budget); }
+    const FrameBudget& getBudget() const { return m_budget; }
+
+    // Change how spawned particles get their shapes and vertex counts
+    void setEmitter(const EmitterConfig& emitter) { m_emitter = emitter; }
+    const EmitterConfig& getEmitter() const { return m_emitter; }
+
+    // Let particles collide with each other (off by default); call before run()
+    // for the threaded timestep
+    void setCollisions(const CollisionConfig& collisions) { m_particles.setCollisions(collisions); }
+    const CollisionConfig& getCollisions() const { return m_particles.getCollisions(); }
+
+    // Drop particles as soon as they can never come back on screen (on by
+    // default). A window resized larger only shows particles from then on.
+    void setRetireOffscreen(bool retire) { m_particles.setRetireOffscreen(retire); }
+    size_t getCulledCount() const { return m_particles.culledCount(); }
+
+    // Level of detail for small particles (on by default, see LodConfig)
+    void setLod(const LodConfig& lod) { m_particles.setLod(lod); }
+    const LodConfig& getLod() const { return m_particles.getLod(); }
+
+    // Preallocate for this many live particles, so that a load that stays
+    // below it never allocates once the engine is running
+    void reserve(size_t particles);
+
+    // Simulate at a fixed rate instead of by frame time; call before run().
+    // The threaded mode also keeps rendering from ever waiting on the simulation.
+    void setTimestep(Timestep mode, double ticksPerSecond = 120.0);
+
+    // Advance the simulation by a frame that took frameSeconds, as the
+    // timestep mode says. Returns how far between the last two ticks to draw
+    // (1 for Timestep::Variable).
+    float advance(float frameSeconds);
+
+    // Advance a headless engine by a frame of dtAsSeconds, as advance does.
+    // With buildVertices the draw vertices are generated too, as draw would.
+    void step(float dtAsSeconds, bool buildVertices = false);
+
+    Timestep getTimestep() const { return m_timestep; }
+    double getTickSeconds() const { return m_tickSeconds; }
+    Vector2u getSize() const { return m_size; }
+    bool getRetireOffscreen() const { return m_particles.getRetireOffscreen(); }
+
+    // Save and restore the simulated state: the particles, the spawn
+    // generator and, with a fixed timestep, the time not simulated yet.
+    // The settings are not part of it. readState leaves no particles and
+    // returns false if the data is not a valid state.
+    void writeState(ByteWriter& out) const;
+    bool readState(ByteReader& in);
+
+    // Record every frame from now on to path, for Replay (see Recording.h):
+    // a checksum every checksumEvery frames and a snapshot every
+    // snapshotEvery, 0 for none after the first. Frames are recorded as
+    // advance and step simulate them, with the spawns made before them.
+    // Not available with Timestep::Threaded, whose ticks do not follow frames.
+    bool startRecording(const string& path, unsigned checksumEvery = 60, unsigned snapshotEvery = 600);
+    void stopRecording();
+    const RecordingWriter* getRecorder() const { return m_recorder.get(); }
+
+    size_t getParticleCount() const { return m_particles.size(); }
+    size_t getVertexCount() const { return m_particles.vertexCount(); }
+    unsigned long long getChecksum() const { return m_particles.checksum(); }
+
+    // Draw the frame into a software framebuffer the size of the screen, as
+    // draw would into the window, alpha of the way into the last step.
+    // The update threads, if any, share the work.
+    void rasterize(SoftwareRasterizer& target, float alpha = 1.0f);
+
+    // The simulation thread, once Timestep::Threaded has started it
+    const Simulation* getSimulation() const { return m_simulation.get(); }
+
+    // Update particles on this many threads (0 = one per core).
+    // 1, the default, updates on the main thread only. The simulation thread
+    // takes the count when it starts; later calls do not change it.
+    void setUpdateThreads(unsigned threads);
+
+    // Record per-phase frame timings (see Profiler.h). Without
+    // PARTICLES_PROFILING the timers are compiled out and this does nothing.
+    void setProfiling(bool enabled) { m_profiling = enabled; }
+    const FrameProfiler& getProfiler() const { return m_profiler; }
+
+    // Also write the timings to path every everyFrames frames, as CSV rows or,
+    // for a path ending in .json, as one JSON summary line per period.
+    // Turns profiling on. Returns false if the file cannot be opened.
+    bool setProfileExport(const string& path, unsigned everyFrames = 600);
+
     // Provides access to the game window
     RenderWindow& getWindow() { return m_Window; }
 };
@@ -0,0 +1,184 @@
+#include "FrameBudget.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // Below this many particles the fixed cost of a frame swamps theirs, so
+    // the cost per particle is not estimated
+    const size_t kMinMeasured = 64;
+
+    // While throttled, the gap between the population and the cap is closed
+    // at this many seconds' pace: a population far below the cap still fills
+    // quickly, one near it only as fast as particles expire
+    const double kFillSeconds = 0.5;
+}
+
+FrameBudget::FrameBudget() : m_workNs(0), m_overFrames(0), m_underFrames(0), m_allowance(0.0)
+{
+}
+
+void FrameBudget::setConfig(const BudgetConfig& config)
+{
+    m_config = config;
+    m_stats = Stats();
+    m_workNs = 0;
+    m_overFrames = 0;
+    m_underFrames = 0;
+    m_allowance = 0.0;
+}
+
+void FrameBudget::beginWork()
+{
+    if (m_config.enabled)
+    {
+        m_workStart = Clock::now();
+    }
+}
+
+void FrameBudget::endWork()
+{
+    if (m_config.enabled)
+    {
+        m_workNs += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - m_workStart).count());
+    }
+}
+
+void FrameBudget::endFrame(size_t particles)
+{
+    const double workMs = m_workNs / 1e6;
+    m_workNs = 0;
+    endFrame(workMs, particles);
+}
+
+void FrameBudget::endFrame(double workMs, size_t particles)
+{
+    if (!m_config.enabled)
+    {
+        return;
+    }
+    Stats& s = m_stats;
+    s.lastMs = workMs;
+    s.smoothedMs = s.smoothedMs > 0.0 ? s.smoothedMs + m_config.smoothing * (workMs - s.smoothedMs) : workMs;
+
+    // Aim for the middle of the band between the thresholds, where the level holds
+    if (particles >= kMinMeasured && s.smoothedMs > 0.0)
+    {
+        const double aimMs = 0.5 * (m_config.degradeAbove + m_config.recoverBelow) * m_config.targetMs;
+        s.particleCap = static_cast<size_t>(particles * aimMs / s.smoothedMs);
+    }
+
+    if (s.smoothedMs > m_config.targetMs * m_config.degradeAbove)
+    {
+        m_underFrames = 0;
+        if (++m_overFrames >= m_config.degradeFrames && s.level != BudgetLevel::Shedding)
+        {
+            setLevel(static_cast<BudgetLevel>(static_cast<int>(s.level) + 1));
+        }
+    }
+    else if (s.smoothedMs < m_config.targetMs * m_config.recoverBelow)
+    {
+        m_overFrames = 0;
+        if (++m_underFrames >= m_config.recoverFrames && s.level != BudgetLevel::Normal)
+        {
+            setLevel(static_cast<BudgetLevel>(static_cast<int>(s.level) - 1));
+        }
+    }
+    else
+    {
+        // Within the band: hold the level
+        m_overFrames = 0;
+        m_underFrames = 0;
+    }
+}
+
+void FrameBudget::setLevel(BudgetLevel level)
+{
+    m_stats.level = level;
+    m_stats.levelChanges++;
+    m_overFrames = 0;
+    m_underFrames = 0;
+    m_allowance = 0.0;
+}
+
+void FrameBudget::beginFrame(float dt, size_t particles)
+{
+    if (!m_config.enabled || m_stats.level == BudgetLevel::Normal)
+    {
+        return;
+    }
+    // Never past the cap, however much was saved up
+    const double headroom = m_stats.particleCap > particles ? static_cast<double>(m_stats.particleCap - particles) : 0.0;
+    m_stats.spawnRate = headroom / kFillSeconds;
+    m_allowance = min(m_allowance + m_stats.spawnRate * dt, headroom);
+}
+
+int FrameBudget::admit(int count)
+{
+    if (!m_config.enabled)
+    {
+        return count;
+    }
+    int admitted = count;
+    if (m_stats.level == BudgetLevel::Shedding)
+    {
+        admitted = 0;
+    }
+    else if (m_stats.level != BudgetLevel::Normal && m_stats.particleCap > 0)
+    {
+        admitted = static_cast<int>(min(static_cast<double>(count), floor(m_allowance)));
+        m_allowance -= admitted;
+    }
+    m_stats.requested += static_cast<uint64_t>(count);
+    m_stats.admitted += static_cast<uint64_t>(admitted);
+    return admitted;
+}
+
+void FrameBudget::limitPoints(const EmitterConfig& emitter, int& minPoints, int& maxPoints) const
+{
+    if (!m_config.enabled || m_stats.level < BudgetLevel::Reduced)
+    {
+        return;
+    }
+    if (minPoints < 2 || maxPoints < minPoints)
+    {
+        minPoints = emitter.minPoints;
+        maxPoints = emitter.maxPoints;
+    }
+    // The lowest quarter of the range
+    maxPoints = minPoints + (maxPoints - minPoints) / 4;
+}
+
+size_t FrameBudget::shedCount(size_t particles) const
+{
+    const size_t cap = m_stats.particleCap;
+    if (!m_config.enabled || m_stats.level != BudgetLevel::Shedding || cap == 0 || particles <= cap)
+    {
+        return 0;
+    }
+    // A few percent a frame, so the crowd thins instead of vanishing
+    const size_t most = max<size_t>(1, static_cast<size_t>(particles * m_config.shedPerFrame));
+    return min(particles - cap, most);
+}
+
+string FrameBudget::summary() const
+{
+    ostringstream out;
+    out << fixed << setprecision(1) << "budget " << m_config.targetMs << " ms: " << levelName(m_stats.level) << ", "
+        << m_stats.smoothedMs << " ms, cap " << m_stats.particleCap << ", admitted " << m_stats.admitted << "/"
+        << m_stats.requested << ", shed " << m_stats.shed << ", " << m_stats.levelChanges << " level changes";
+    return out.str();
+}
+
+const char* FrameBudget::levelName(BudgetLevel level)
+{
+    switch (level)
+    {
+        case BudgetLevel::Throttled: return "throttled";
+        case BudgetLevel::Reduced: return "reduced";
+        case BudgetLevel::Shedding: return "shedding";
+        default: return "normal";
+    }
+}
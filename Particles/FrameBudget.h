@@ -0,0 +1,106 @@
+#pragma once
+#include "ShapeLibrary.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// A frame-time budget for the engine to hold (off by default)
+struct BudgetConfig
+{
+    bool enabled = false;
+    double targetMs = 16.6;       // Work per frame, update and draw, not waiting for the display
+    double degradeAbove = 1.0;    // Degrade once the smoothed cost is over this share of the target...
+    double recoverBelow = 0.7;    // ...and recover once it is under this one
+    int degradeFrames = 10;       // Frames in a row over before degrading one level
+    int recoverFrames = 90;       // Frames in a row under before recovering one level
+    double smoothing = 0.1;       // Weight of the newest frame in the smoothed cost
+    double shedPerFrame = 0.02;   // Share of the particles retired per frame, at most, when shedding
+};
+
+// How far the budget has cut back, each level adding to the ones before
+enum class BudgetLevel : uint8_t
+{
+    Normal,    // Every spawn asked for is made
+    Throttled, // Spawns limited to what brings the population up to the cap
+    Reduced,   // New particles get the low end of the emitter's vertex counts, prebuilt shapes too
+    Shedding   // No spawns, and the oldest particles go until the population is at the cap
+};
+
+// Adapts particle admission to a frame-time budget. The engine times the
+// work of each frame with beginWork and endWork and files it with endFrame;
+// the controller keeps a smoothed cost and an estimate of how many particles
+// fit the budget, the cap, at the cost per particle measured so far.
+//
+// The level only moves after the smoothed cost has stayed past a threshold
+// for a run of frames, and the thresholds to degrade and to recover are apart:
+// a cost in between, or one that keeps crossing a threshold, holds the level.
+// Degrading takes fewer frames than recovering, so overload is answered fast
+// and recovery does not bounce straight back into it.
+class FrameBudget
+{
+public:
+    typedef chrono::steady_clock Clock;
+
+    struct Stats
+    {
+        BudgetLevel level = BudgetLevel::Normal;
+        double lastMs = 0.0;          // Work of the last frame
+        double smoothedMs = 0.0;
+        size_t particleCap = 0;       // Particles that fit the budget, 0 until measured
+        double spawnRate = 0.0;       // Particles per second admitted, when throttled
+        uint64_t requested = 0;       // Particles asked for so far
+        uint64_t admitted = 0;        // Of which spawned
+        uint64_t shed = 0;            // Particles retired early
+        uint64_t levelChanges = 0;
+    };
+
+    FrameBudget();
+
+    // Replace the settings; the measurements start over
+    void setConfig(const BudgetConfig& config);
+    const BudgetConfig& config() const { return m_config; }
+    bool enabled() const { return m_config.enabled; }
+
+    // Time a piece of the frame's work; a frame may have several
+    void beginWork();
+    void endWork();
+
+    // File the frame: the work timed since the last one, or workMs measured
+    // by the caller, with particles live at its end
+    void endFrame(size_t particles);
+    void endFrame(double workMs, size_t particles);
+
+    // Admission for a frame that lasts dt and starts with particles live:
+    // call beginFrame once, then admit once per spawn asked for, which
+    // returns how many of count to make
+    void beginFrame(float dt, size_t particles);
+    int admit(int count);
+
+    // The vertex count range to spawn with, given the one asked for (0s for
+    // the emitter's): narrowed to its low end from BudgetLevel::Reduced on
+    void limitPoints(const EmitterConfig& emitter, int& minPoints, int& maxPoints) const;
+
+    // Oldest particles to retire now, out of particles, and the count retired
+    size_t shedCount(size_t particles) const;
+    void shed(size_t particles) { m_stats.shed += particles; }
+
+    const Stats& stats() const { return m_stats; }
+
+    // One line for the overlay, e.g. "budget 16.6 ms: throttled, 11.2 ms, cap 4200"
+    string summary() const;
+
+    static const char* levelName(BudgetLevel level);
+
+private:
+    BudgetConfig m_config;
+    Stats m_stats;
+    Clock::time_point m_workStart;
+    uint64_t m_workNs;                // Timed so far this frame
+    int m_overFrames;                 // Frames in a row over the degrade threshold
+    int m_underFrames;                // Frames in a row under the recover threshold
+    double m_allowance;               // Particles that may still be spawned, when throttled
+
+    void setLevel(BudgetLevel level);
+};
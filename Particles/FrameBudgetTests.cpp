@@ -0,0 +1,84 @@
+#include "Tests.h"
+#include "FrameBudget.h"
+#include "ParticleSystem.h"
+
+bool testFrameBudget()
+{
+    // Synthetic frame costs against a 10 ms budget: the level moves one step
+    // per run of frames past a threshold, and holds between the thresholds or
+    // while the cost keeps crossing one. Each level cuts admission further.
+    FrameBudget budget;
+    BudgetConfig budgetConfig;
+    budgetConfig.enabled = true;
+    budgetConfig.targetMs = 10.0;
+    budgetConfig.smoothing = 1.0; // Every frame counts in full
+    budgetConfig.degradeFrames = 5;
+    budgetConfig.recoverFrames = 20;
+    budget.setConfig(budgetConfig);
+    auto budgetFrames = [&](int count, double ms, size_t particles) {
+        for (int f = 0; f < count; f++)
+        {
+            budget.endFrame(ms, particles);
+        }
+    };
+    budgetFrames(4, 12.0, 1000);
+    bool budgetPassed = budget.stats().level == BudgetLevel::Normal && budget.admit(100) == 100;
+    budgetFrames(1, 12.0, 1000);
+    // 1000 particles cost 12 ms, so 708 fit the 8.5 ms between the thresholds
+    budgetPassed = budgetPassed && budget.stats().level == BudgetLevel::Throttled && budget.stats().particleCap == 708;
+    budgetFrames(100, 9.0, 1000);
+    for (int f = 0; f < 50; f++)
+    {
+        budget.endFrame(f % 4 == 3 ? 6.0 : 12.0, 1000);
+    }
+    budgetPassed = budgetPassed && budget.stats().level == BudgetLevel::Throttled && budget.stats().levelChanges == 1;
+
+    // Throttled: up to the cap and no further
+    budget.beginFrame(1.0f, 500);
+    budgetPassed = budgetPassed && budget.admit(1000) == 208 && budget.admit(10) == 0
+        && budget.stats().requested == 1110 && budget.stats().admitted == 308;
+    budget.beginFrame(1.0f, 800);
+    budgetPassed = budgetPassed && budget.admit(10) == 0;
+    int budgetMin = 0, budgetMax = 0;
+    budget.limitPoints(EmitterConfig(), budgetMin, budgetMax);
+    budgetPassed = budgetPassed && budgetMin == 0 && budgetMax == 0;
+
+    budgetFrames(10, 12.0, 1000);
+    budget.limitPoints(EmitterConfig(), budgetMin, budgetMax);
+    budget.beginFrame(1.0f, 0);
+    budgetPassed = budgetPassed && budget.stats().level == BudgetLevel::Shedding && budget.admit(5) == 0
+        && budgetMin == 25 && budgetMax == 31 && budget.shedCount(1000) == 20 && budget.shedCount(700) == 0;
+
+    // The reduced range holds for prebuilt shapes too
+    EmitterConfig prebuilt;
+    prebuilt.shapes = ShapeSource::Prebuilt;
+    ParticleSystem reduced;
+    Random reducedRandom(31);
+    for (int i = 0; i < 50 && budgetPassed; i++)
+    {
+        reduced.spawn(Vector2u(1920, 1080), withPointRange(prebuilt, budgetMin, budgetMax), Vector2i(960, 540), reducedRandom);
+        budgetPassed = reduced.particleVertexCount(i) >= 25 && reduced.particleVertexCount(i) <= 31;
+    }
+
+    // Shedding retires the oldest particles, leaving the rest in spawn order
+    ParticleSystem crowd;
+    Random crowdRandom(25);
+    for (int i = 0; i < 30; i++)
+    {
+        crowd.spawn(Vector2u(1920, 1080), EmitterConfig(), Vector2i(i * 50, 540), crowdRandom);
+    }
+    const Vector2f survivor = crowd.position(20);
+    size_t survivorVertices = 0;
+    for (size_t i = 20; i < crowd.size(); i++)
+    {
+        survivorVertices += static_cast<size_t>(crowd.particleVertexCount(i));
+    }
+    budgetPassed = budgetPassed && crowd.retireOldest(20) == 20 && crowd.size() == 10 && crowd.position(0) == survivor
+        && crowd.vertexCount() == survivorVertices && crowd.retireOldest(50) == 10 && crowd.size() == 0;
+
+    budgetFrames(19, 5.0, 700);
+    budgetPassed = budgetPassed && budget.stats().level == BudgetLevel::Shedding;
+    budgetFrames(1, 5.0, 700);
+    budgetPassed = budgetPassed && budget.stats().level == BudgetLevel::Reduced;
+    return budgetPassed;
+}
@@ -0,0 +1,143 @@
+#include "FrameExporter.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    bool endsWith(const string& s, const char* suffix)
+    {
+        const string end(suffix);
+        return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+    }
+
+    // Whether pattern has exactly one conversion, a %d with optional flags
+    // and width, besides %% escapes; it is handed to snprintf as the format
+    bool isFramePattern(const string& pattern)
+    {
+        int conversions = 0;
+        for (size_t i = 0; i < pattern.size(); i++)
+        {
+            if (pattern[i] != '%')
+            {
+                continue;
+            }
+            if (++i < pattern.size() && pattern[i] == '%')
+            {
+                continue;
+            }
+            while (i < pattern.size() && (pattern[i] == '0' || pattern[i] == '-' || (pattern[i] >= '1' && pattern[i] <= '9')))
+            {
+                i++;
+            }
+            if (i == pattern.size() || pattern[i] != 'd')
+            {
+                return false;
+            }
+            conversions++;
+        }
+        return conversions == 1;
+    }
+}
+
+FrameExporter::FrameExporter() : m_format(Format::Raw), m_raw(nullptr), m_ownsRaw(false), m_frames(0)
+{
+}
+
+FrameExporter::~FrameExporter()
+{
+    close();
+}
+
+bool FrameExporter::open(const string& pattern)
+{
+    close();
+    m_pattern = pattern;
+    m_frames = 0;
+    if (pattern == "-")
+    {
+        m_format = Format::Raw;
+        m_raw = stdout;
+        m_ownsRaw = false;
+        return true;
+    }
+    if (pattern.find('%') != string::npos)
+    {
+        if (!isFramePattern(pattern))
+        {
+            return false;
+        }
+        m_format = endsWith(pattern, ".png") ? Format::Png : Format::Ppm;
+        return true;
+    }
+    m_format = Format::Raw;
+    m_raw = fopen(pattern.c_str(), "wb");
+    m_ownsRaw = true;
+    return m_raw != nullptr;
+}
+
+void FrameExporter::close()
+{
+    if (m_raw)
+    {
+        if (m_ownsRaw)
+        {
+            fclose(m_raw);
+        }
+        else
+        {
+            fflush(m_raw);
+        }
+    }
+    m_raw = nullptr;
+}
+
+bool FrameExporter::write(const Uint8* pixels, unsigned width, unsigned height)
+{
+    const size_t size = static_cast<size_t>(width) * height * 4;
+    bool written = false;
+    if (m_format == Format::Raw)
+    {
+        written = m_raw && fwrite(pixels, 1, size, m_raw) == size;
+    }
+    else
+    {
+        char path[4096];
+        snprintf(path, sizeof(path), m_pattern.c_str(), static_cast<int>(m_frames));
+        if (m_format == Format::Png)
+        {
+            Image image;
+            image.create(width, height, pixels);
+            written = image.saveToFile(path);
+        }
+        else
+        {
+            written = writePpm(path, pixels, width, height);
+        }
+    }
+    m_frames += written;
+    return written;
+}
+
+bool FrameExporter::writePpm(const string& path, const Uint8* pixels, unsigned width, unsigned height)
+{
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out)
+    {
+        return false;
+    }
+    // PPM has no alpha: RGB triples, one row at a time
+    vector<Uint8> row(static_cast<size_t>(width) * 3);
+    bool ok = fprintf(out, "P6\n%u %u\n255\n", width, height) > 0;
+    for (unsigned y = 0; y < height && ok; y++)
+    {
+        const Uint8* source = pixels + static_cast<size_t>(y) * width * 4;
+        for (unsigned x = 0; x < width; x++)
+        {
+            row[3 * x] = source[4 * x];
+            row[3 * x + 1] = source[4 * x + 1];
+            row[3 * x + 2] = source[4 * x + 2];
+        }
+        ok = fwrite(row.data(), 1, row.size(), out) == row.size();
+    }
+    return fclose(out) == 0 && ok;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+using namespace sf;
+using namespace std;
+
+// Writes rendered frames out, as an image sequence or a raw stream.
+// The destination is chosen by the pattern given to open:
+// - "-": raw frames to standard output, e.g. to pipe into a video encoder
+// - a name with a printf-style frame number, such as "frames/%05d.png":
+//   one image per frame, PNG or binary PPM by the extension
+// - any other name: raw frames appended to that file or named pipe
+// A raw frame is width * height RGBA pixels, rows from the top, and nothing
+// else; the reader is told the size some other way.
+class FrameExporter
+{
+public:
+    FrameExporter();
+    ~FrameExporter();
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    // False if the pattern cannot be used: its raw file cannot be created,
+    // or its frame number is not a single %d, such as %05d
+    bool open(const string& pattern);
+    void close();
+
+    // Write one frame of RGBA pixels; false if it could not be written
+    bool write(const Uint8* pixels, unsigned width, unsigned height);
+
+    uint64_t frames() const { return m_frames; }
+
+private:
+    enum class Format
+    {
+        Raw,
+        Ppm,
+        Png
+    };
+
+    string m_pattern;
+    Format m_format;
+    FILE* m_raw;                      // The raw stream, when writing one
+    bool m_ownsRaw;                   // Not standard output
+    uint64_t m_frames;
+
+    bool writePpm(const string& path, const Uint8* pixels, unsigned width, unsigned height);
+};
@@ -0,0 +1,396 @@
+#include "InputSource.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    const char* skipSpace(const char* p, const char* end)
+    {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    // A decimal integer at p, which must end at a space or the end of the
+    // line; p is moved past it
+    bool parseInt(const char*& p, const char* end, int& value)
+    {
+        const bool negative = p != end && *p == '-';
+        if (negative || (p != end && *p == '+'))
+        {
+            p++;
+        }
+        const char* digits = p;
+        long long magnitude = 0;
+        while (p != end && *p >= '0' && *p <= '9')
+        {
+            magnitude = magnitude * 10 + (*p - '0');
+            if (magnitude > 1000000000)
+            {
+                return false;
+            }
+            p++;
+        }
+        if (p == digits || (p != end && *p != ' ' && *p != '\t' && *p != '\r'))
+        {
+            return false;
+        }
+        value = static_cast<int>(negative ? -magnitude : magnitude);
+        return true;
+    }
+
+    // "x y count [minPoints maxPoints]" and nothing else
+    bool parseSpawn(const char* p, const char* end, SpawnCommand& command)
+    {
+        int values[5];
+        int fields = 0;
+        for (p = skipSpace(p, end); p != end && fields < 5; p = skipSpace(p, end))
+        {
+            if (!parseInt(p, end, values[fields]))
+            {
+                return false;
+            }
+            fields++;
+        }
+        if (p != end || (fields != 3 && fields != 5) || values[2] < 1 || values[2] > SpawnCommand::kMaxCount)
+        {
+            return false;
+        }
+        command.position = Vector2i(values[0], values[1]);
+        command.count = values[2];
+        command.minPoints = 0;
+        command.maxPoints = 0;
+        if (fields == 5)
+        {
+            if (values[3] < 2 || values[4] < values[3] || values[4] > SpawnCommand::kMaxPoints)
+            {
+                return false;
+            }
+            command.minPoints = values[3];
+            command.maxPoints = values[4];
+        }
+        return true;
+    }
+
+    // Blank and comment lines carry no command
+    bool isEmptyLine(const char* p, const char* end)
+    {
+        p = skipSpace(p, end);
+        return p == end || *p == '#';
+    }
+}
+
+const int SpawnCommand::kMaxCount;
+const int SpawnCommand::kMaxPoints;
+const size_t StreamInput::kBufferSize;
+const int StreamInput::kMaxReadsPerPoll;
+
+MouseInput::MouseInput(const RenderWindow& window, int count) : m_window(window), m_count(count), m_pressed(false), m_clicks(0)
+{
+}
+
+void MouseInput::handleEvent(const Event& event)
+{
+    if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+    {
+        m_pressed = true;
+        m_clicks++;
+    }
+    if (event.type == Event::MouseButtonReleased && event.mouseButton.button == Mouse::Left)
+    {
+        m_pressed = false;
+    }
+}
+
+void MouseInput::poll(float, vector<SpawnCommand>& out)
+{
+    // Each press spawns once more, even if the button is already up again
+    const int spawns = m_clicks + (m_pressed ? 1 : 0);
+    m_clicks = 0;
+    if (spawns == 0)
+    {
+        return;
+    }
+    SpawnCommand command;
+    command.position = Mouse::getPosition(m_window);
+    command.count = m_count * spawns;
+    out.push_back(command);
+}
+
+ScriptedInput::ScriptedInput() : m_next(0), m_time(0.0)
+{
+}
+
+bool ScriptedInput::load(const string& path, string& error)
+{
+    ifstream in(path.c_str());
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    return load(in, error);
+}
+
+bool ScriptedInput::load(istream& in, string& error)
+{
+    vector<Burst> bursts;
+    string line;
+    for (int number = 1; getline(in, line); number++)
+    {
+        const char* begin = line.c_str();
+        const char* end = begin + line.size();
+        if (isEmptyLine(begin, end))
+        {
+            continue;
+        }
+        Burst burst;
+        char* after = nullptr;
+        burst.time = strtod(begin, &after);
+        if (after == begin || !std::isfinite(burst.time) || burst.time < 0.0 || !parseSpawn(after, end, burst.command))
+        {
+            error = "line " + to_string(number) + ": expected time x y count [minPoints maxPoints]";
+            return false;
+        }
+        bursts.push_back(burst);
+    }
+    stable_sort(bursts.begin(), bursts.end(), [](const Burst& a, const Burst& b) { return a.time < b.time; });
+    m_bursts.swap(bursts);
+    rewind();
+    return true;
+}
+
+void ScriptedInput::rewind()
+{
+    m_next = 0;
+    m_time = 0.0;
+}
+
+void ScriptedInput::poll(float dt, vector<SpawnCommand>& out)
+{
+    m_time += dt;
+    for (; m_next < m_bursts.size() && m_bursts[m_next].time <= m_time; m_next++)
+    {
+        out.push_back(m_bursts[m_next].command);
+    }
+}
+
+StreamInput::StreamInput() : m_fd(-1), m_listener(-1), m_stdinFlags(-1), m_ended(false), m_size(0), m_discarding(false)
+{
+}
+
+StreamInput::~StreamInput()
+{
+    close();
+}
+
+bool StreamInput::openStdin()
+{
+    close();
+    // Reads must not block the frame: standard input is made non-blocking
+    // until the stream is closed
+    const int flags = fcntl(STDIN_FILENO, F_GETFL);
+    if (flags < 0 || fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return false;
+    }
+    m_stdinFlags = flags;
+    m_fd = STDIN_FILENO;
+    m_ended = false;
+    return true;
+}
+
+bool StreamInput::listen(const string& path, string& error)
+{
+    close();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        error = "socket path empty or too long";
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            error = path + " exists and is not a socket";
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        error = strerror(errno);
+        return false;
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, 4) < 0
+        || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        error = strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    m_listener = fd;
+    m_socketPath = path;
+    m_ended = false;
+    return true;
+}
+
+void StreamInput::close()
+{
+    if (m_fd >= 0 && m_fd != STDIN_FILENO)
+    {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    if (m_stdinFlags >= 0)
+    {
+        fcntl(STDIN_FILENO, F_SETFL, m_stdinFlags);
+        m_stdinFlags = -1;
+    }
+    if (m_listener >= 0)
+    {
+        ::close(m_listener);
+        unlink(m_socketPath.c_str());
+        m_listener = -1;
+    }
+    m_socketPath.clear();
+    m_size = 0;
+    m_discarding = false;
+}
+
+void StreamInput::poll(float, vector<SpawnCommand>& out)
+{
+    // One client at a time; the next waits in the backlog
+    if (m_fd < 0 && m_listener >= 0)
+    {
+        const int client = accept(m_listener, nullptr, nullptr);
+        if (client >= 0)
+        {
+            if (fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK) < 0)
+            {
+                ::close(client);
+                return;
+            }
+            m_fd = client;
+            m_stats.clients++;
+        }
+    }
+
+    for (int reads = 0; m_fd >= 0 && reads < kMaxReadsPerPoll; reads++)
+    {
+        const ssize_t n = read(m_fd, m_buffer + m_size, kBufferSize - m_size);
+        if (n > 0)
+        {
+            m_size += static_cast<size_t>(n);
+            m_stats.bytes += static_cast<uint64_t>(n);
+            consume(out);
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        else if (n == 0 || errno != EINTR)
+        {
+            endOfFeed(out);
+        }
+    }
+}
+
+void StreamInput::feed(const char* data, size_t size, vector<SpawnCommand>& out)
+{
+    while (size > 0)
+    {
+        const size_t n = min(size, kBufferSize - m_size);
+        memcpy(m_buffer + m_size, data, n);
+        m_size += n;
+        m_stats.bytes += n;
+        data += n;
+        size -= n;
+        consume(out);
+    }
+}
+
+void StreamInput::consume(vector<SpawnCommand>& out)
+{
+    const char* start = m_buffer;
+    const char* end = m_buffer + m_size;
+    while (const char* newline = static_cast<const char*>(memchr(start, '\n', static_cast<size_t>(end - start))))
+    {
+        if (m_discarding)
+        {
+            m_discarding = false;
+        }
+        else
+        {
+            parseLine(start, newline, out);
+        }
+        start = newline + 1;
+    }
+
+    // A line filling the whole buffer can never be parsed: drop it up to its end
+    if (!m_discarding && start == m_buffer && m_size == kBufferSize)
+    {
+        m_stats.rejected++;
+        m_discarding = true;
+    }
+    m_size = m_discarding ? 0 : static_cast<size_t>(end - start);
+    memmove(m_buffer, start, m_size);
+}
+
+void StreamInput::parseLine(const char* begin, const char* end, vector<SpawnCommand>& out)
+{
+    if (isEmptyLine(begin, end))
+    {
+        return;
+    }
+    SpawnCommand command;
+    if (parseSpawn(begin, end, command))
+    {
+        out.push_back(command);
+        m_stats.commands++;
+    }
+    else
+    {
+        m_stats.rejected++;
+    }
+}
+
+void StreamInput::endOfFeed(vector<SpawnCommand>& out)
+{
+    if (m_size > 0 && !m_discarding)
+    {
+        parseLine(m_buffer, m_buffer + m_size, out);
+    }
+    m_size = 0;
+    m_discarding = false;
+    if (m_fd == STDIN_FILENO)
+    {
+        m_ended = true;
+        fcntl(STDIN_FILENO, F_SETFL, m_stdinFlags);
+        m_stdinFlags = -1;
+    }
+    else
+    {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+using namespace sf;
+using namespace std;
+
+// A spawn asked for by an input source: count particles at a pixel position
+struct SpawnCommand
+{
+    // Limits on commands read from a schedule or a feed
+    static const int kMaxCount = 10000;
+    static const int kMaxPoints = 1000;
+
+    Vector2i position;
+    int count = 0;
+    int minPoints = 0;                // Vertex count range, 0s for the emitter's
+    int maxPoints = 0;
+};
+
+// Where an engine's spawns come from. The engine hands it every window event
+// and then polls it once per frame for the spawns of that frame.
+class InputSource
+{
+public:
+    virtual ~InputSource() {}
+
+    // A window event, for sources that follow the window
+    virtual void handleEvent(const Event&) {}
+
+    // Append the spawns of a frame that took dt seconds to out
+    virtual void poll(float dt, vector<SpawnCommand>& out) = 0;
+
+    // True once the source will never ask for another spawn
+    virtual bool finished() const { return false; }
+};
+
+// Spawns where the window's mouse is, while the left button is held down:
+// count particles per frame, and count more on the frame it is pressed
+class MouseInput : public InputSource
+{
+public:
+    explicit MouseInput(const RenderWindow& window, int count = 5);
+
+    void handleEvent(const Event& event) override;
+    void poll(float dt, vector<SpawnCommand>& out) override;
+
+private:
+    const RenderWindow& m_window;
+    int m_count;
+    bool m_pressed;                   // The left button is down
+    int m_clicks;                     // Presses since the last poll
+};
+
+// Spawns from a schedule, one burst per line:
+//     time x y count [minPoints maxPoints]
+// time is in seconds from the first frame, x and y in pixels. Blank lines
+// and lines starting with # are skipped. Bursts are played in time order,
+// those at the same time in the order listed, each in the first frame that
+// reaches its time.
+class ScriptedInput : public InputSource
+{
+public:
+    ScriptedInput();
+
+    // Replace the schedule; false, with the line at fault in error, if it
+    // does not parse
+    bool load(const string& path, string& error);
+    bool load(istream& in, string& error);
+
+    void poll(float dt, vector<SpawnCommand>& out) override;
+    bool finished() const override { return m_next == m_bursts.size(); }
+
+    // Play the schedule again from the start
+    void rewind();
+
+    size_t size() const { return m_bursts.size(); }
+    double duration() const { return m_bursts.empty() ? 0.0 : m_bursts.back().time; }
+
+private:
+    struct Burst
+    {
+        double time;
+        SpawnCommand command;
+    };
+
+    vector<Burst> m_bursts;
+    size_t m_next;                    // First burst not played yet
+    double m_time;                    // Seconds played so far
+};
+
+// Spawns from a live feed of text commands, one per line:
+//     x y count [minPoints maxPoints]
+// read from standard input or from a local UNIX socket, whose clients are
+// served one at a time. The feed is never waited for: each poll takes
+// whatever has arrived. Lines are parsed in place in a fixed buffer, so a
+// feed costs no allocation per command. Lines that do not parse, or do not
+// fit in the buffer, are counted and skipped. When the feed ends, a last
+// line without a newline is parsed too.
+class StreamInput : public InputSource
+{
+public:
+    struct Stats
+    {
+        uint64_t commands = 0;        // Commands parsed
+        uint64_t rejected = 0;        // Lines skipped as malformed or too long
+        uint64_t bytes = 0;           // Bytes read
+        uint64_t clients = 0;         // Socket connections accepted
+    };
+
+    StreamInput();
+    ~StreamInput();
+
+    StreamInput(const StreamInput&) = delete;
+    StreamInput& operator=(const StreamInput&) = delete;
+
+    // Read commands from standard input until it ends
+    bool openStdin();
+
+    // Listen on a UNIX socket at path, replacing a stale socket left there.
+    // False, with the reason in error, if it cannot be created.
+    bool listen(const string& path, string& error);
+
+    void close();
+
+    void poll(float dt, vector<SpawnCommand>& out) override;
+    bool finished() const override { return m_ended; }
+
+    // Parse data as if it had just arrived on the feed
+    void feed(const char* data, size_t size, vector<SpawnCommand>& out);
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    static const size_t kBufferSize = 64 * 1024;
+    static const int kMaxReadsPerPoll = 16;  // Leave the rest to later frames
+
+    int m_fd;                         // Standard input or the client, -1 if none
+    int m_listener;                   // The listening socket, -1 if none
+    string m_socketPath;
+    int m_stdinFlags;                 // To restore, -1 if not changed
+    bool m_ended;                     // Standard input reached its end
+
+    char m_buffer[kBufferSize];       // Bytes of lines not complete yet
+    size_t m_size;
+    bool m_discarding;                // Skipping the rest of a line too long to keep
+    Stats m_stats;
+
+    // Parse the complete lines in the buffer and keep the rest
+    void consume(vector<SpawnCommand>& out);
+    void parseLine(const char* begin, const char* end, vector<SpawnCommand>& out);
+
+    // The client or standard input is done
+    void endOfFeed(vector<SpawnCommand>& out);
+};
@@ -0,0 +1,43 @@
+#include "Tests.h"
+#include "InputSource.h"
+#include "ParticleSystem.h"
+#include <sstream>
+
+bool testInput()
+{
+    // A schedule plays in time order, each burst in the first frame to reach
+    // it; a feed is parsed across partial reads and skips malformed lines.
+    // Spawns with a vertex range get vertex counts from it.
+    ScriptedInput script;
+    string scriptError;
+    istringstream schedule("# time x y count [minPoints maxPoints]\n0.5 10 20 3\n0 1 2 4 8 8\n\n0.5 5 5 1\n");
+    vector<SpawnCommand> commands;
+    bool inputPassed = script.load(schedule, scriptError) && script.size() == 3;
+    script.poll(0.25f, commands);
+    inputPassed = inputPassed && commands.size() == 1 && commands[0].count == 4 && commands[0].minPoints == 8;
+    script.poll(0.25f, commands);
+    inputPassed = inputPassed && commands.size() == 3 && commands[1].position == Vector2i(10, 20)
+        && commands[2].position == Vector2i(5, 5) && script.finished();
+    istringstream badSchedule("0 1 2 3\n1 2 3\n");
+    inputPassed = inputPassed && !script.load(badSchedule, scriptError) && scriptError.compare(0, 7, "line 2:") == 0;
+
+    StreamInput stream;
+    const string feed = "10 20 3\n5 5 1 4 8\nbad\n7 7 0\n-3 9 2\r\n";
+    commands.clear();
+    stream.feed(feed.data(), 12, commands);
+    stream.feed(feed.data() + 12, feed.size() - 12, commands);
+    inputPassed = inputPassed && commands.size() == 3 && commands[1].position == Vector2i(5, 5) && commands[1].maxPoints == 8
+        && commands[2].position == Vector2i(-3, 9) && stream.stats().commands == 3 && stream.stats().rejected == 2;
+
+    ParticleSystem ranged;
+    Random rangedRandom(12);
+    const EmitterConfig eights = withPointRange(EmitterConfig(), 8, 8);
+    const EmitterConfig unchanged = withPointRange(EmitterConfig(), 9, 3);
+    for (int i = 0; i < 5; i++)
+    {
+        ranged.spawn(Vector2u(1920, 1080), eights, Vector2i(960, 540), rangedRandom);
+    }
+    inputPassed = inputPassed && ranged.vertexCount() == 40 && unchanged.minPoints == EmitterConfig().minPoints
+        && unchanged.maxPoints == EmitterConfig().maxPoints;
+    return inputPassed;
+}
@@ -2,57 +2,113 @@
 
 namespace Matrices
 {
-    Matrix::Matrix(int _rows, int _cols) : rows(_rows), cols(_cols)
+    template <typename T>
+    BasicMatrix<T>::BasicMatrix(int _rows, int _cols) : a(_rows * _cols, T(0)), rows(_rows), cols(_cols)
     {
-        a.resize(rows);
-        for (int i = 0; i < rows; ++i)
+        // Single allocation, all elements initialized to 0
+    }
+
+    template <typename T>
+    void BasicMatrix<T>::checkIndex(int i, int j) const
+    {
+        if (i < 0 || i >= rows || j < 0 || j >= cols)
         {
-            a[i].resize(cols, 0.0); // Initialize all elements to 0.0
+            throw std::out_of_range("Matrix index out of range.");
         }
     }
 
-    Matrix operator+(const Matrix& a, const Matrix& b)
+    template <typename T>
+    BasicMatrix<T>& BasicMatrix<T>::operator+=(const BasicMatrix& b)
     {
         // Ensure matrices have the same dimensions for addition.
-        if (a.getRows() != b.getRows() || a.getCols() != b.getCols())
+        if (rows != b.rows || cols != b.cols)
         {
             throw std::invalid_argument("Matrices must have the same dimensions for addition.");
         }
 
-        Matrix result(a.getRows(), a.getCols());
-        for (int i = 0; i < a.getRows(); ++i)
+        for (size_t k = 0; k < a.size(); ++k)
         {
-            for (int j = 0; j < a.getCols(); ++j)
-            {
-                result(i, j) = a(i, j) + b(i, j); // Add corresponding elements.
-            }
+            a[k] += b.a[k]; // Add corresponding elements.
+        }
+        return *this;
+    }
+
+    template <typename T>
+    BasicMatrix<T>& BasicMatrix<T>::operator*=(T c)
+    {
+        for (size_t k = 0; k < a.size(); ++k)
+        {
+            a[k] *= c;
         }
+        return *this;
+    }
+
+    template <typename T>
+    BasicMatrix<T> operator+(const BasicMatrix<T>& a, const BasicMatrix<T>& b)
+    {
+        BasicMatrix<T> result = a;
+        result += b;
         return result;
     }
 
-    Matrix operator*(const Matrix& a, const Matrix& b)
+    template <typename T>
+    void multiplyInto(BasicMatrix<T>& dst, const BasicMatrix<T>& a, const BasicMatrix<T>& b)
     {
         // Ensure the number of columns in the first matrix equals the number of rows in the second.
         if (a.getCols() != b.getRows())
         {
             throw std::invalid_argument("Number of columns in first matrix must equal number of rows in second matrix for multiplication.");
         }
+        if (dst.getRows() != a.getRows() || dst.getCols() != b.getCols())
+        {
+            throw std::invalid_argument("Destination matrix has the wrong dimensions for multiplication.");
+        }
+        if (&dst == &a)
+        {
+            throw std::invalid_argument("Destination matrix cannot be the left operand of a multiplication.");
+        }
 
-        Matrix result(a.getRows(), b.getCols());
-        for (int i = 0; i < a.getRows(); ++i)
+        // Column j of the result only reads column j of b, so each column is
+        // computed into a small buffer first; that makes dst == b safe.
+        const int kStackRows = 8;
+        T stackColumn[kStackRows];
+        vector<T> heapColumn;
+        T* column = stackColumn;
+        if (a.getRows() > kStackRows)
+        {
+            heapColumn.resize(a.getRows());
+            column = heapColumn.data();
+        }
+
+        for (int j = 0; j < b.getCols(); ++j)
         {
-            for (int j = 0; j < b.getCols(); ++j)
+            for (int i = 0; i < a.getRows(); ++i)
             {
+                const T* aRow = a.row(i);
+                T sum = 0;
                 for (int k = 0; k < a.getCols(); ++k)
                 {
-                    result(i, j) += a(i, k) * b(k, j); // Perform matrix multiplication.
+                    sum += aRow[k] * b(k, j); // Perform matrix multiplication.
                 }
+                column[i] = sum;
+            }
+            for (int i = 0; i < a.getRows(); ++i)
+            {
+                dst(i, j) = column[i];
             }
         }
+    }
+
+    template <typename T>
+    BasicMatrix<T> operator*(const BasicMatrix<T>& a, const BasicMatrix<T>& b)
+    {
+        BasicMatrix<T> result(a.getRows(), b.getCols());
+        multiplyInto(result, a, b);
         return result;
     }
 
-    bool operator==(const Matrix& a, const Matrix& b)
+    template <typename T>
+    bool operator==(const BasicMatrix<T>& a, const BasicMatrix<T>& b)
     {
         // Matrices must have the same dimensions to be equal.
         if (a.getRows() != b.getRows() || a.getCols() != b.getCols())
@@ -74,13 +130,15 @@ namespace Matrices
         return true;
     }
 
-    bool operator!=(const Matrix& a, const Matrix& b)
+    template <typename T>
+    bool operator!=(const BasicMatrix<T>& a, const BasicMatrix<T>& b)
     {
         // Not equal is the opposite of equal.
         return !(a == b);
     }
 
-    ostream& operator<<(ostream& os, const Matrix& a)
+    template <typename T>
+    ostream& operator<<(ostream& os, const BasicMatrix<T>& a)
     {
         for (int i = 0; i < a.getRows(); ++i)
         {
@@ -93,31 +151,114 @@ namespace Matrices
         return os;
     }
 
-    RotationMatrix::RotationMatrix(double theta) : Matrix(2, 2)
+    template <typename T>
+    BasicRotationMatrix<T>::BasicRotationMatrix(double theta) : BasicMatrix<T>(2, 2)
     {
         // Initialize the 2x2 rotation matrix.
-        a[0][0] = cos(theta);
-        a[0][1] = -sin(theta);
-        a[1][0] = sin(theta);
-        a[1][1] = cos(theta);
+        (*this)(0, 0) = static_cast<T>(cos(theta));
+        (*this)(0, 1) = static_cast<T>(-sin(theta));
+        (*this)(1, 0) = static_cast<T>(sin(theta));
+        (*this)(1, 1) = static_cast<T>(cos(theta));
     }
 
-    ScalingMatrix::ScalingMatrix(double scale) : Matrix(2, 2)
+    template <typename T>
+    BasicScalingMatrix<T>::BasicScalingMatrix(double scale) : BasicMatrix<T>(2, 2)
     {
         // Initialize the 2x2 scaling matrix.
-        a[0][0] = scale;
-        a[0][1] = 0;
-        a[1][0] = 0;
-        a[1][1] = scale;
+        (*this)(0, 0) = static_cast<T>(scale);
+        (*this)(0, 1) = 0;
+        (*this)(1, 0) = 0;
+        (*this)(1, 1) = static_cast<T>(scale);
     }
 
-    TranslationMatrix::TranslationMatrix(double xShift, double yShift, int nCols) : Matrix(2, nCols)
+    template <typename T>
+    BasicTranslationMatrix<T>::BasicTranslationMatrix(double xShift, double yShift, int nCols) : BasicMatrix<T>(2, nCols)
     {
         // Initialize the 2xn translation matrix.
         for (int j = 0; j < nCols; ++j)
         {
-            a[0][j] = xShift;
-            a[1][j] = yShift;
+            (*this)(0, j) = static_cast<T>(xShift);
+            (*this)(1, j) = static_cast<T>(yShift);
         }
     }
+
+    template <typename T>
+    BasicAffineTransform<T> BasicAffineTransform<T>::identity()
+    {
+        BasicAffineTransform t;
+        t.m00 = 1; t.m01 = 0; t.m02 = 0;
+        t.m10 = 0; t.m11 = 1; t.m12 = 0;
+        return t;
+    }
+
+    template <typename T>
+    BasicAffineTransform<T> BasicAffineTransform<T>::aboutCenter(double theta, double c, double cx, double cy,
+                                                                 double xShift, double yShift)
+    {
+        // Linear part is c * R(theta); the offset keeps (cx, cy) fixed and then shifts it.
+        double cosTheta = c * cos(theta);
+        double sinTheta = c * sin(theta);
+        BasicAffineTransform t;
+        t.m00 = static_cast<T>(cosTheta);
+        t.m01 = static_cast<T>(-sinTheta);
+        t.m10 = static_cast<T>(sinTheta);
+        t.m11 = static_cast<T>(cosTheta);
+        t.m02 = static_cast<T>(cx + xShift - (cosTheta * cx - sinTheta * cy));
+        t.m12 = static_cast<T>(cy + yShift - (sinTheta * cx + cosTheta * cy));
+        return t;
+    }
+
+    template <typename T>
+    BasicAffineTransform<T> BasicAffineTransform<T>::pose(double theta, double c, double x, double y)
+    {
+        return aboutCenter(theta, c, 0.0, 0.0, x, y);
+    }
+
+    template <typename T>
+    void BasicAffineTransform<T>::apply(BasicMatrix<T>& a) const
+    {
+        if (a.getRows() != 2)
+        {
+            throw std::invalid_argument("Affine transforms apply to 2xn matrices only.");
+        }
+
+        apply(a.row(0), a.row(1), a.getCols());
+    }
+
+    template <typename T>
+    void BasicAffineTransform<T>::apply(T* x, T* y, int n) const
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            T px = x[j];
+            T py = y[j];
+            x[j] = m00 * px + m01 * py + m02;
+            y[j] = m10 * px + m11 * py + m12;
+        }
+    }
+
+    // The two element types the library is built for
+    template class BasicMatrix<double>;
+    template class BasicMatrix<float>;
+    template class BasicRotationMatrix<double>;
+    template class BasicRotationMatrix<float>;
+    template class BasicScalingMatrix<double>;
+    template class BasicScalingMatrix<float>;
+    template class BasicTranslationMatrix<double>;
+    template class BasicTranslationMatrix<float>;
+    template struct BasicAffineTransform<double>;
+    template struct BasicAffineTransform<float>;
+
+    template Matrix operator+(const Matrix& a, const Matrix& b);
+    template MatrixF operator+(const MatrixF& a, const MatrixF& b);
+    template Matrix operator*(const Matrix& a, const Matrix& b);
+    template MatrixF operator*(const MatrixF& a, const MatrixF& b);
+    template void multiplyInto(Matrix& dst, const Matrix& a, const Matrix& b);
+    template void multiplyInto(MatrixF& dst, const MatrixF& a, const MatrixF& b);
+    template bool operator==(const Matrix& a, const Matrix& b);
+    template bool operator==(const MatrixF& a, const MatrixF& b);
+    template bool operator!=(const Matrix& a, const Matrix& b);
+    template bool operator!=(const MatrixF& a, const MatrixF& b);
+    template ostream& operator<<(ostream& os, const Matrix& a);
+    template ostream& operator<<(ostream& os, const MatrixF& a);
 }
@@ -5,69 +5,121 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include <stdexcept>
 using namespace std;
 
 namespace Matrices
 {
-    class Matrix
+    // Dense matrix of elements of type T, double or float.
+    // Matrix is the double one and MatrixF the float one; the operations
+    // are defined in Matrices.cpp for those two.
+    template <typename T>
+    class BasicMatrix
     {
         public:
+            typedef T Scalar;
+
             // Construct a matrix with given rows and columns.
             // Initializes all elements to 0.
-            Matrix(int _rows, int _cols);
+            BasicMatrix(int _rows, int _cols);
 
             // Inline accessors/mutators:
 
-            // Read element at (row i, column j)
+            // Read element at (row i, column j), unchecked
             // Example: double x = a(i,j);
-            const double& operator()(int i, int j) const
+            const T& operator()(int i, int j) const
             {
-                return a.at(i).at(j);
+                return a[i * cols + j];
             }
 
-            // Assign element at (row i, column j)
+            // Assign element at (row i, column j), unchecked
             // Example: a(i,j) = x;
-            double& operator()(int i, int j)
+            T& operator()(int i, int j)
+            {
+                return a[i * cols + j];
+            }
+
+            // Checked versions of the above for debugging.
+            // Throw out_of_range if (i, j) is outside the matrix.
+            const T& at(int i, int j) const
             {
-                return a.at(i).at(j);
+                checkIndex(i, j);
+                return a[i * cols + j];
             }
 
+            T& at(int i, int j)
+            {
+                checkIndex(i, j);
+                return a[i * cols + j];
+            }
+
+            // Row i as a contiguous array of getCols() elements
+            // Example: double* x = a.row(0);
+            const T* row(int i) const { return a.data() + i * cols; }
+            T* row(int i) { return a.data() + i * cols; }
+
             int getRows() const { return rows; }
             int getCols() const { return cols; }
             // End of inline accessors/mutators
+
+            // Add b to this matrix in place.
+            // Example: a += b;
+            BasicMatrix& operator+=(const BasicMatrix& b);
+
+            // Multiply every element by c in place.
+            // Example: a *= 0.5;
+            BasicMatrix& operator*=(T c);
         protected:
-            // Changed to protected so subclasses can modify
-            vector<vector<double>> a;
+            // Elements in one row-major buffer: (i, j) is a[i * cols + j]
+            vector<T> a;
         private:
             int rows;
             int cols;
+
+            void checkIndex(int i, int j) const;
     };
 
+    typedef BasicMatrix<double> Matrix;
+    typedef BasicMatrix<float> MatrixF;
+
     // Add corresponding elements of two matrices.
     // Example: c = a + b;
-    Matrix operator+(const Matrix& a, const Matrix& b);
+    template <typename T>
+    BasicMatrix<T> operator+(const BasicMatrix<T>& a, const BasicMatrix<T>& b);
 
     // Matrix multiplication.
     // Example: c = a * b;
-    Matrix operator*(const Matrix& a, const Matrix& b);
+    template <typename T>
+    BasicMatrix<T> operator*(const BasicMatrix<T>& a, const BasicMatrix<T>& b);
+
+    // Matrix multiplication into an existing matrix, without allocating.
+    // dst must already be a.getRows() x b.getCols().
+    // dst may be b itself when a is square, e.g. A = R * A in place, but not a.
+    // Example: multiplyInto(c, a, b);
+    template <typename T>
+    void multiplyInto(BasicMatrix<T>& dst, const BasicMatrix<T>& a, const BasicMatrix<T>& b);
 
     // Check if two matrices are equal.
     // Example: a == b
-    bool operator==(const Matrix& a, const Matrix& b);
+    template <typename T>
+    bool operator==(const BasicMatrix<T>& a, const BasicMatrix<T>& b);
 
     // Check if two matrices are not equal.
     // Example: a != b
-    bool operator!=(const Matrix& a, const Matrix& b);
+    template <typename T>
+    bool operator!=(const BasicMatrix<T>& a, const BasicMatrix<T>& b);
 
     // Output matrix to stream.
     // Columns separated by spaces, rows by newlines.
-    ostream& operator<<(ostream& os, const Matrix& a);
+    template <typename T>
+    ostream& operator<<(ostream& os, const BasicMatrix<T>& a);
 
     /*******************************************************************************/
 
     // 2D rotation matrix.
     // A = R * A rotates A by theta radians counter-clockwise.
-    class RotationMatrix : public Matrix
+    template <typename T>
+    class BasicRotationMatrix : public BasicMatrix<T>
     {
         public:
             // Create a 2x2 rotation matrix.
@@ -75,12 +127,13 @@ namespace Matrices
             //   cos(theta)  -sin(theta)
             //   sin(theta)   cos(theta)
             // theta: rotation angle in radians (counter-clockwise)
-            RotationMatrix(double theta);
+            BasicRotationMatrix(double theta);
     };
 
     // 2D scaling matrix.
     // A = S * A scales A by a factor.
-    class ScalingMatrix : public Matrix
+    template <typename T>
+    class BasicScalingMatrix : public BasicMatrix<T>
     {
         public:
             // Create a 2x2 scaling matrix.
@@ -88,12 +141,13 @@ namespace Matrices
             //   scale   0
             //   0       scale
             // scale: scaling factor
-            ScalingMatrix(double scale);
+            BasicScalingMatrix(double scale);
     };
 
     // 2D translation matrix.
     // A = T + A shifts A by (xShift, yShift).
-    class TranslationMatrix : public Matrix
+    template <typename T>
+    class BasicTranslationMatrix : public BasicMatrix<T>
     {
         public:
             // Create a 2xn translation matrix.
@@ -102,8 +156,168 @@ namespace Matrices
             //   yShift  yShift  yShift  ...
             // xShift: horizontal shift, yShift: vertical shift, nCols: number of columns
             // nCols: number of (x, y) coordinate pairs.
-            TranslationMatrix(double xShift, double yShift, int nCols);
+            BasicTranslationMatrix(double xShift, double yShift, int nCols);
     };
+
+    typedef BasicRotationMatrix<double> RotationMatrix;
+    typedef BasicScalingMatrix<double> ScalingMatrix;
+    typedef BasicTranslationMatrix<double> TranslationMatrix;
+    typedef BasicRotationMatrix<float> RotationMatrixF;
+    typedef BasicScalingMatrix<float> ScalingMatrixF;
+    typedef BasicTranslationMatrix<float> TranslationMatrixF;
+
+    /*******************************************************************************/
+
+    // Matrix whose dimensions are fixed at compile time.
+    // Elements are stored inline in row-major order, so it never touches the heap
+    // and loops over it have constant trip counts the compiler can unroll.
+    template <int R, int C, typename T = double>
+    class FixedMatrix
+    {
+        public:
+            // All elements 0
+            constexpr FixedMatrix() : a() {}
+
+            // Elements listed row by row
+            // Example: FixedMatrix<2, 2> m(1, 2,
+            //                              3, 4);
+            template <typename... Values>
+            constexpr FixedMatrix(T first, Values... rest) : a{first, static_cast<T>(rest)...}
+            {
+                static_assert(sizeof...(Values) + 1 == R * C, "FixedMatrix needs one value per element.");
+            }
+
+            constexpr const T& operator()(int i, int j) const { return a[i * C + j]; }
+            T& operator()(int i, int j) { return a[i * C + j]; }
+
+            static constexpr int getRows() { return R; }
+            static constexpr int getCols() { return C; }
+        protected:
+            T a[R * C];
+    };
+
+    // Fixed-size matrix multiplication.
+    // Example: FixedMatrix<2, 2> c = a * b;
+    template <int R, int K, int C, typename T>
+    FixedMatrix<R, C, T> operator*(const FixedMatrix<R, K, T>& a, const FixedMatrix<K, C, T>& b)
+    {
+        FixedMatrix<R, C, T> result;
+        for (int i = 0; i < R; ++i)
+        {
+            for (int j = 0; j < C; ++j)
+            {
+                for (int k = 0; k < K; ++k)
+                {
+                    result(i, j) += a(i, k) * b(k, j);
+                }
+            }
+        }
+        return result;
+    }
+
+    // 2x2 times 2xn into an existing matrix, as one straight-line pass over the columns.
+    // dst must already be 2 x b.getCols() and may be b itself.
+    // Example: multiplyInto(A, R, A);
+    template <typename T, typename S>
+    void multiplyInto(BasicMatrix<S>& dst, const FixedMatrix<2, 2, T>& a, const BasicMatrix<S>& b)
+    {
+        if (b.getRows() != 2 || dst.getRows() != 2 || dst.getCols() != b.getCols())
+        {
+            throw std::invalid_argument("2x2 matrices multiply 2xn matrices of matching size only.");
+        }
+
+        const S a00 = static_cast<S>(a(0, 0)), a01 = static_cast<S>(a(0, 1));
+        const S a10 = static_cast<S>(a(1, 0)), a11 = static_cast<S>(a(1, 1));
+        const S* x = b.row(0);
+        const S* y = b.row(1);
+        S* xOut = dst.row(0);
+        S* yOut = dst.row(1);
+        const int n = b.getCols();
+        for (int j = 0; j < n; ++j)
+        {
+            const S px = x[j];
+            const S py = y[j];
+            xOut[j] = a00 * px + a01 * py;
+            yOut[j] = a10 * px + a11 * py;
+        }
+    }
+
+    // 2x2 times 2xn.
+    // Example: c = R * a;
+    template <typename T, typename S>
+    BasicMatrix<S> operator*(const FixedMatrix<2, 2, T>& a, const BasicMatrix<S>& b)
+    {
+        BasicMatrix<S> result(2, b.getCols());
+        multiplyInto(result, a, b);
+        return result;
+    }
+
+    // Heap-free 2D rotation matrix, same elements as RotationMatrix.
+    template <typename T>
+    class BasicFixedRotationMatrix : public FixedMatrix<2, 2, T>
+    {
+        public:
+            // From a precomputed cosine and sine, usable in constant expressions
+            // Example: constexpr FixedRotationMatrix quarterTurn(0.0, 1.0);
+            constexpr BasicFixedRotationMatrix(T cosTheta, T sinTheta)
+                : FixedMatrix<2, 2, T>(cosTheta, -sinTheta,
+                                       sinTheta, cosTheta) {}
+
+            // theta: rotation angle in radians (counter-clockwise)
+            explicit BasicFixedRotationMatrix(T theta)
+                : BasicFixedRotationMatrix(cos(theta), sin(theta)) {}
+    };
+
+    // Heap-free 2D scaling matrix, same elements as ScalingMatrix.
+    template <typename T>
+    class BasicFixedScalingMatrix : public FixedMatrix<2, 2, T>
+    {
+        public:
+            constexpr explicit BasicFixedScalingMatrix(T scale)
+                : FixedMatrix<2, 2, T>(scale, 0,
+                                       0, scale) {}
+    };
+
+    typedef BasicFixedRotationMatrix<double> FixedRotationMatrix;
+    typedef BasicFixedScalingMatrix<double> FixedScalingMatrix;
+
+    /*******************************************************************************/
+
+    // 2D affine transform stored as a 2x3 matrix:
+    //   m00  m01  m02
+    //   m10  m11  m12
+    // Maps (x, y) to (m00*x + m01*y + m02, m10*x + m11*y + m12).
+    // Composing rotation, scaling and translation into one of these lets a 2xn
+    // vertex matrix be transformed in a single pass with no temporaries.
+    // The factories work in double and round the result to T once.
+    template <typename T>
+    struct BasicAffineTransform
+    {
+        T m00, m01, m02;
+        T m10, m11, m12;
+
+        // Leaves every point where it is.
+        static BasicAffineTransform identity();
+
+        // Rotate by theta radians counter-clockwise and scale by c, both about
+        // (cx, cy), then shift by (xShift, yShift).
+        // Same result as R * (A - C) + C, then S * (A - C) + C, then T + A.
+        static BasicAffineTransform aboutCenter(double theta, double c, double cx, double cy,
+                                                double xShift, double yShift);
+
+        // Rotate by theta and scale by c about the origin, then move the origin
+        // to (x, y): maps a shape in local coordinates to its place in the world.
+        static BasicAffineTransform pose(double theta, double c, double x, double y);
+
+        // Transform every column of a 2xn matrix in place.
+        void apply(BasicMatrix<T>& a) const;
+
+        // Transform n points stored as separate x and y arrays in place.
+        void apply(T* x, T* y, int n) const;
+    };
+
+    typedef BasicAffineTransform<double> AffineTransform;
+    typedef BasicAffineTransform<float> AffineTransformF;
 }
 
 #endif // MATRIX_H_INCLUDED
@@ -1,65 +1,105 @@
 #include "Particle.h"
+#include "VertexKernels.h"
 #include <SFML/Graphics.hpp>
 #include <iostream>
 #include <cmath>
 
-Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition)
+Transform cartesianToPixel(Vector2u targetSize)
+{
+    // x' = x + width / 2, y' = height / 2 - y
+    return Transform(1.f, 0.f, 0.5f * static_cast<float>(targetSize.x),
+                     0.f, -1.f, 0.5f * static_cast<float>(targetSize.y),
+                     0.f, 0.f, 1.f);
+}
+
+FloatRect cartesianViewport(Vector2u targetSize)
+{
+    const float width = static_cast<float>(targetSize.x);
+    const float height = static_cast<float>(targetSize.y);
+    return FloatRect(-0.5f * width, -0.5f * height, width, height);
+}
+
+Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition, Random& random)
+    : Particle(target.getSize(), numPoints, mouseClickPosition, random)
+{
+}
+
+Particle::Particle(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random)
     : m_A(2, numPoints)
 {
     m_ttl = TTL;
     m_numPoints = numPoints;
-    m_radiansPerSec = static_cast<float>(rand()) / (RAND_MAX) * static_cast<float>(M_PI);
-
-    m_cartesianPlane.setCenter(0.f, 0.f);
-    m_cartesianPlane.setSize(static_cast<float>(target.getSize().x), -1.0f * static_cast<float>(target.getSize().y));
 
-    m_centerCoordinate = target.mapPixelToCoords(mouseClickPosition, m_cartesianPlane);
-
-    m_vx = static_cast<float>(rand() % 401 + 100);
-    if (rand() % 2) {
-        m_vx *= -1;
-    }
-    m_vy = static_cast<float>(rand() % 401 + 100);
-    if (rand() % 2) {
-        m_vy *= -1;
-    }
+    ParticleSpawn spawn;
+    spawn.generate(targetSize, numPoints, mouseClickPosition, random, m_A.row(0), m_A.row(1));
+    m_centerCoordinate = spawn.center;
+    m_radiansPerSec = spawn.radiansPerSec;
+    m_vx = spawn.vx;
+    m_vy = spawn.vy;
+    m_color1 = spawn.color1;
+    m_color2 = spawn.color2;
+}
 
-    m_color1 = Color::White;
-    m_color2 = Color(rand() % 256, rand() % 256, rand() % 256);
+void ParticleSpawn::generate(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random, ParticleScalar* x, ParticleScalar* y)
+{
+    generateMotion(targetSize, mouseClickPosition, random);
 
-    float theta = static_cast<float>(rand()) / (RAND_MAX) * (static_cast<float>(M_PI) / 2.0f);
+    float theta = random.uniform() * (static_cast<float>(M_PI) / 2.0f);
     float dTheta = 2.0f * static_cast<float>(M_PI) / (numPoints > 1 ? (numPoints -1) : 1) ;
 
+    // Draw every vertex's radius in one batch, parked in x until used
+    random.fillInt(x, numPoints, 20, 80);
+
     for (int j = 0; j < numPoints; j++)
     {
-        float r = static_cast<float>(rand() % 61 + 20);
+        float r = static_cast<float>(x[j]);
         float dx = r * std::cos(theta);
         float dy = r * std::sin(theta);
-        m_A(0, j) = m_centerCoordinate.x + dx;
-        m_A(1, j) = m_centerCoordinate.y + dy;
+        x[j] = center.x + dx;
+        y[j] = center.y + dy;
         theta += dTheta;
     }
 }
 
+void ParticleSpawn::generateMotion(Vector2u targetSize, Vector2i mouseClickPosition, Random& random)
+{
+    radiansPerSec = random.uniform() * static_cast<float>(M_PI);
+
+    // Inverse of cartesianToPixel: the origin is the middle of the target and y points up
+    center.x = static_cast<float>(mouseClickPosition.x) - 0.5f * static_cast<float>(targetSize.x);
+    center.y = 0.5f * static_cast<float>(targetSize.y) - static_cast<float>(mouseClickPosition.y);
+
+    vx = static_cast<float>(random.uniformInt(100, 500));
+    if (random.coinFlip()) {
+        vx *= -1;
+    }
+    vy = static_cast<float>(random.uniformInt(100, 500));
+    if (random.coinFlip()) {
+        vy *= -1;
+    }
+
+    color1 = Color::White;
+    color2 = Color(random.uniformInt(0, 255), random.uniformInt(0, 255), random.uniformInt(0, 255));
+}
+
 void Particle::draw(RenderTarget& target, RenderStates states) const
 {
     VertexArray lines(TriangleFan, m_numPoints + 1);
 
-    sf::Vector2i centerPixelCoords = target.mapCoordsToPixel(m_centerCoordinate, m_cartesianPlane);
-    lines[0].position = sf::Vector2f(static_cast<float>(centerPixelCoords.x), static_cast<float>(centerPixelCoords.y));
+    // Vertices stay in Cartesian coordinates; the transform maps them to pixels
+    lines[0].position = m_centerCoordinate;
     lines[0].color = m_color1;
 
     for (int j = 1; j <= m_numPoints; j++)
     {
         // m_A stores world coordinates for each vertex
-        sf::Vector2f vertexWorldCoords(
+        lines[j].position = sf::Vector2f(
             static_cast<float>(m_A(0, j - 1)),
             static_cast<float>(m_A(1, j - 1))
         );
-        sf::Vector2i vertexPixelCoords = target.mapCoordsToPixel(vertexWorldCoords, m_cartesianPlane);
-        lines[j].position = sf::Vector2f(static_cast<float>(vertexPixelCoords.x), static_cast<float>(vertexPixelCoords.y));
         lines[j].color = m_color2;
     }
+    states.transform *= cartesianToPixel(target.getSize());
     target.draw(lines, states);
 }
 
@@ -68,20 +108,29 @@ void Particle::update(float dt)
     m_ttl -= dt;
 
     if (m_ttl > 0) {
-        rotate(dt * m_radiansPerSec);
-        scale(SCALE);
-
         float dx = m_vx * dt;
         m_vy -= G * dt;
         float dy = m_vy * dt;
-        translate(dx, dy);
+
+        // Rotate, scale and translate fused into one vectorized pass over m_A
+        ParticleTransform T = ParticleTransform::aboutCenter(dt * m_radiansPerSec, SCALE,
+            m_centerCoordinate.x, m_centerCoordinate.y, dx, dy);
+        VertexKernels::transform(T, m_A.row(0), m_A.row(1), m_A.getCols());
+
+        m_centerCoordinate.x += dx;
+        m_centerCoordinate.y += dy;
     }
 }
 
 void Particle::translate(double xShift, double yShift)
 {
-    TranslationMatrix T(xShift, yShift, m_A.getCols());
-    m_A = T + m_A;
+    // Shift the rows directly rather than adding a TranslationMatrix, so no heap allocation
+    ParticleScalar* x = m_A.row(0);
+    ParticleScalar* y = m_A.row(1);
+    for (int j = 0; j < m_A.getCols(); ++j) {
+        x[j] += static_cast<ParticleScalar>(xShift);
+        y[j] += static_cast<ParticleScalar>(yShift);
+    }
 
     m_centerCoordinate.x += static_cast<float>(xShift);
     m_centerCoordinate.y += static_cast<float>(yShift);
@@ -96,8 +145,8 @@ void Particle::rotate(double theta)
         m_A(1,j) -= originalCenter.y;
     }
 
-    RotationMatrix R(theta);
-    m_A = R * m_A;
+    FixedRotationMatrix R(theta);
+    multiplyInto(m_A, R, m_A);
 
     // Move vertices back to the original center
     for(int j=0; j < m_A.getCols(); ++j) {
@@ -115,8 +164,8 @@ void Particle::scale(double c)
         m_A(1,j) -= originalCenter.y;
     }
 
-    ScalingMatrix S(c);
-    m_A = S * m_A;
+    FixedScalingMatrix S(c);
+    multiplyInto(m_A, S, m_A);
 
     // Move vertices back to the original center
     for(int j=0; j < m_A.getCols(); ++j) {
@@ -193,6 +242,36 @@ void Particle::unitTests()
         cout << "Failed." << endl;
     }
 
+    cout << "Testing FixedRotationMatrix and FixedScalingMatrix against the dynamic matrices..." << endl;
+    constexpr FixedRotationMatrix quarterTurn(0.0, 1.0);
+    constexpr FixedScalingMatrix doubleSize(2.0);
+    Matrix points(2, 5);
+    for (int j = 0; j < points.getCols(); ++j)
+    {
+        points(0, j) = j * 1.5 - 3;
+        points(1, j) = 7 - j * 2.25;
+    }
+    Matrix fixedResult = FixedRotationMatrix(rot_theta) * (doubleSize * (quarterTurn * points));
+    Matrix dynamicResult = RotationMatrix(rot_theta) * (ScalingMatrix(2.0) * (RotationMatrix(M_PI / 2.0) * points));
+    bool fixedPassed = true;
+    for (int j = 0; j < points.getCols(); ++j)
+    {
+        if (!almostEqual(fixedResult(0, j), dynamicResult(0, j)) || !almostEqual(fixedResult(1, j), dynamicResult(1, j)))
+        {
+            fixedPassed = false;
+        }
+    }
+
+    if (fixedPassed)
+    {
+        cout << "Passed.  +1" << endl;
+        score++;
+    }
+    else
+    {
+        cout << "Failed." << endl;
+    }
+
     cout << "Testing Particles..." << endl;
     cout << "Testing Particle initial m_centerCoordinate..." << endl;
     // Create a Particle with a known mouse position for reliable testing.
@@ -212,7 +291,7 @@ void Particle::unitTests()
     }
 
     cout << "Applying one rotation of 90 degrees about the particle's center..." << endl;
-    Matrix initialCoords = m_A;
+    ParticleMatrix initialCoords = m_A;
     rotate(M_PI / 2.0);
     bool rotationPassed = true;
     if (m_A.getCols() == initialCoords.getCols()) {
@@ -322,5 +401,46 @@ void Particle::unitTests()
         cout << "Failed." << endl;
     }
 
-    cout << "Score: " << score << " / 7 (Note: Particle origin test corrected)" << endl;
+    cout << "Applying one fused update against rotate, scale and translate..." << endl;
+    initialCoords = m_A;
+    initialCenter = m_centerCoordinate;
+    float initialTTL = m_ttl;
+    float initialVy = m_vy;
+    float updateDt = 1.0f / 60.0f;
+    float expectedDx = m_vx * updateDt;
+    float expectedDy = (m_vy - G * updateDt) * updateDt;
+    rotate(updateDt * m_radiansPerSec);
+    scale(SCALE);
+    translate(expectedDx, expectedDy);
+    ParticleMatrix expectedCoords = m_A;
+    m_A = initialCoords;
+    m_centerCoordinate = initialCenter;
+    update(updateDt);
+    bool fusedPassed = true;
+    for (int j = 0; j < initialCoords.getCols(); j++)
+    {
+        if (!almostEqual(m_A(0, j), expectedCoords(0, j)) || !almostEqual(m_A(1, j), expectedCoords(1, j)))
+        {
+            cout << "Failed mapping for fused update: ";
+            cout << "Point " << j << ": Got (" << m_A(0, j) << ", " << m_A(1, j) << ")";
+            cout << " Expected (" << expectedCoords(0, j) << ", " << expectedCoords(1, j) << ")" << endl;
+            fusedPassed = false;
+        }
+    }
+
+    if (fusedPassed)
+    {
+        cout << "Passed.  +1" << endl;
+        score++;
+    }
+    else
+    {
+        cout << "Failed." << endl;
+    }
+    m_A = initialCoords; // Restore particle state
+    m_centerCoordinate = initialCenter;
+    m_ttl = initialTTL;
+    m_vy = initialVy;
+
+    cout << "Score: " << score << " / 9 (Note: Particle origin test corrected)" << endl;
 }
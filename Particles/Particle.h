@@ -1,5 +1,7 @@
 #pragma once
 #include "Matrices.h"
+#include "Precision.h"
+#include "Random.h"
 #include <SFML/Graphics.hpp>
 
 const float G = 2000;      // Gravity strength
@@ -9,10 +11,41 @@ const float SCALE = 0.999; // Scaling factor per frame
 using namespace Matrices;
 using namespace sf;
 
+// Transform from the particles' Cartesian plane (origin at the center of a
+// target of this size, y up) to the target's pixels, y down.
+// Pass it in RenderStates::transform to draw particle coordinates directly.
+Transform cartesianToPixel(Vector2u targetSize);
+
+// The target's area in the particles' Cartesian plane: left, bottom, width, height
+FloatRect cartesianViewport(Vector2u targetSize);
+
+// Everything drawn at random for a new particle. Shared by Particle's
+// constructor and ParticleSystem::spawn, so both make the same particle
+// from the same generator state.
+struct ParticleSpawn
+{
+    Vector2f center;       // Particle's center
+    float radiansPerSec;   // Rotation speed
+    float vx;              // Horizontal velocity
+    float vy;              // Vertical velocity
+    Color color1;          // Center color
+    Color color2;          // Vertex color
+
+    // Draw a particle spawned at a pixel position of a target of this size,
+    // writing the world coordinates of its numPoints vertices to x and y
+    void generate(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random, ParticleScalar* x, ParticleScalar* y);
+
+    // Draw everything but the shape: the first draws generate makes
+    void generateMotion(Vector2u targetSize, Vector2i mouseClickPosition, Random& random);
+};
+
 class Particle : public Drawable
 {
 public:
-    Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition);
+    // The shape, speed and color are drawn from random, by default this thread's generator
+    Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition, Random& random = Random::threadLocal());
+    // Same, for a target of the given size that does not need to exist, e.g. in benchmarks
+    Particle(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random = Random::threadLocal());
     virtual void draw(RenderTarget& target, RenderStates states) const override;
     void update(float dt);
     float getTTL() { return m_ttl; }
@@ -22,16 +55,17 @@ public:
     void unitTests();
 
 private:
+    friend class ParticleSystem; // Copies a spawned particle into its arrays
+
     float m_ttl;           // Remaining life
     int m_numPoints;       // Number of vertices
     Vector2f m_centerCoordinate; // Particle's center
     float m_radiansPerSec;   // Rotation speed
     float m_vx;              // Horizontal velocity
     float m_vy;              // Vertical velocity
-    View m_cartesianPlane;   // View for coordinate mapping
     Color m_color1;          // Center color
     Color m_color2;          // Vertex color
-    Matrix m_A;              // Matrix for vertex coordinates
+    ParticleMatrix m_A;      // Matrix for vertex coordinates
 
     // Rotate particle counter-clockwise by theta radians
     void rotate(double theta);
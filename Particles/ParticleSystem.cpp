@@ -0,0 +1,855 @@
+#include "ParticleSystem.h"
+#include "VertexKernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+ParticleSystem::ParticleSystem()
+    : m_first(0), m_maxRadius(0.0f), m_vertexTop(0), m_liveVertices(0),
+      m_dropped(0), m_retireOffscreen(false), m_culled(0), m_drawnVertices(0), m_lodSkipped(0), m_retiredOffscreen(0)
+{
+}
+
+void ParticleSystem::add(const Particle& particle)
+{
+    const int offset = allocateVertices(particle.m_numPoints);
+    const ParticleScalar* x = particle.m_A.row(0);
+    const ParticleScalar* y = particle.m_A.row(1);
+    std::copy(x, x + particle.m_numPoints, m_vertexX.begin() + offset);
+    std::copy(y, y + particle.m_numPoints, m_vertexY.begin() + offset);
+    toLocal(offset, particle.m_numPoints, particle.m_centerCoordinate);
+
+    ParticleSpawn spawn;
+    spawn.center = particle.m_centerCoordinate;
+    spawn.radiansPerSec = particle.m_radiansPerSec;
+    spawn.vx = particle.m_vx;
+    spawn.vy = particle.m_vy;
+    spawn.color1 = particle.m_color1;
+    spawn.color2 = particle.m_color2;
+    push(spawn, particle.m_ttl, 0.0, offset, particle.m_numPoints, false);
+}
+
+void ParticleSystem::spawn(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random)
+{
+    // The vertices are generated in place, in a recycled block when there is one
+    const int offset = allocateVertices(numPoints);
+    ParticleSpawn spawn;
+    spawn.generate(targetSize, numPoints, mouseClickPosition, random, m_vertexX.data() + offset, m_vertexY.data() + offset);
+    toLocal(offset, numPoints, spawn.center);
+    push(spawn, TTL, 0.0, offset, numPoints, false);
+}
+
+void ParticleSystem::spawn(Vector2u targetSize, const EmitterConfig& emitter, Vector2i mouseClickPosition, Random& random)
+{
+    if (emitter.shapes == ShapeSource::Generated)
+    {
+        spawn(targetSize, random.uniformInt(emitter.minPoints, emitter.maxPoints), mouseClickPosition, random);
+        return;
+    }
+
+    // The library's shapes all start at angle 0; the random start angle
+    // Particle gives its first vertex becomes the initial rotation of the pose
+    ParticleSpawn spawn;
+    spawn.generateMotion(targetSize, mouseClickPosition, random);
+    const double angle = random.uniform() * (M_PI / 2.0);
+
+    // An empty pool has no shape to share: the tables make one instead
+    if (emitter.shapes == ShapeSource::Prebuilt && emitter.prebuiltShapes > 0)
+    {
+        const int id = m_shapes.prebuiltShape(emitter.prebuiltShapes, emitter.minPoints, emitter.maxPoints, random);
+        push(spawn, TTL, angle, id, m_shapes.shapePoints(id), true);
+        return;
+    }
+
+    const int numPoints = random.uniformInt(emitter.minPoints, emitter.maxPoints);
+    const int offset = allocateVertices(numPoints);
+    m_shapes.generate(numPoints, random, m_vertexX.data() + offset, m_vertexY.data() + offset);
+    push(spawn, TTL, angle, offset, numPoints, false);
+}
+
+void ParticleSystem::toLocal(int offset, int numPoints, Vector2f center)
+{
+    for (int j = 0; j < numPoints; j++)
+    {
+        m_vertexX[offset + j] -= center.x;
+        m_vertexY[offset + j] -= center.y;
+    }
+}
+
+void ParticleSystem::push(const ParticleSpawn& spawn, float ttl, double angle, int offset, int numPoints, bool shared)
+{
+    m_liveVertices += numPoints;
+
+    m_center.push_back(spawn.center);
+    m_vx.push_back(spawn.vx);
+    m_vy.push_back(spawn.vy);
+    m_ttl.push_back(ttl);
+    m_radiansPerSec.push_back(spawn.radiansPerSec);
+    m_angle.push_back(angle);
+    m_scale.push_back(1.0);
+    m_previousCenter.push_back(spawn.center);
+    m_previousAngle.push_back(angle);
+    m_previousScale.push_back(1.0);
+    m_color1.push_back(spawn.color1);
+    m_color2.push_back(spawn.color2);
+    m_vertexOffset.push_back(offset);
+    m_vertexCount.push_back(numPoints);
+    m_sharedShape.push_back(shared);
+
+    const ParticleScalar* x = shared ? m_shapes.shapeX(offset) : m_vertexX.data() + offset;
+    const ParticleScalar* y = shared ? m_shapes.shapeY(offset) : m_vertexY.data() + offset;
+    double radius2 = 0.0;
+    for (int j = 0; j < numPoints; j++)
+    {
+        radius2 = max(radius2, static_cast<double>(x[j]) * x[j] + static_cast<double>(y[j]) * y[j]);
+    }
+    const float radius = static_cast<float>(sqrt(radius2));
+    m_radius.push_back(radius);
+    m_maxRadius = max(m_maxRadius, radius);
+}
+
+void ParticleSystem::update(float dt, ThreadPool* pool)
+{
+    advance(dt, pool);
+    compact();
+}
+
+void ParticleSystem::advance(float dt, ThreadPool* pool)
+{
+    // Particles are independent of each other, so the per-particle work can be
+    // split across threads; the results do not depend on how it is split.
+    const size_t count = size();
+    m_keep.resize(m_ttl.size());
+    if (pool)
+    {
+        // Captures kept small enough for function to store them without
+        // allocating: the frame's inputs and outputs go by one reference
+        struct Frame
+        {
+            float dt;
+            atomic<size_t> dropped;
+        } frame;
+        frame.dt = dt;
+        frame.dropped.store(0, memory_order_relaxed);
+        pool->parallelFor(count, kUpdateGrain, [this, &frame](size_t begin, size_t end) {
+            frame.dropped.fetch_add(updateRange(m_first + begin, m_first + end, frame.dt), memory_order_relaxed);
+        });
+        m_dropped = frame.dropped.load(memory_order_relaxed);
+    }
+    else
+    {
+        m_dropped = updateRange(m_first, m_first + count, dt);
+    }
+
+    if (m_collisions.enabled)
+    {
+        collide(pool);
+    }
+}
+
+void ParticleSystem::indexParticles(ThreadPool* pool)
+{
+    m_grid.build(m_center.data() + m_first, size(), pool);
+}
+
+void ParticleSystem::collide(ThreadPool* pool)
+{
+    // Every response is worked out before any is applied, so no particle sees
+    // another's half-resolved state
+    indexParticles(pool);
+    const size_t count = size();
+    m_pushes.resize(count);
+    m_impulses.resize(count);
+    if (pool)
+    {
+        pool->parallelFor(count, kUpdateGrain, [this](size_t begin, size_t end) {
+            collideRange(begin, end);
+        });
+        pool->parallelFor(count, kUpdateGrain, [this](size_t begin, size_t end) {
+            applyCollisions(begin, end);
+        });
+    }
+    else
+    {
+        collideRange(0, count);
+        applyCollisions(0, count);
+    }
+}
+
+void ParticleSystem::collideRange(size_t begin, size_t end)
+{
+    // Each overlapping pair pushes both particles apart by a share of the
+    // overlap and, if they are closing in, exchanges the normal part of their
+    // velocities as equal masses do. Both particles of a pair compute the same
+    // response with opposite signs, so momentum is conserved.
+    // [begin, end) counts in grid order, so neighboring particles are
+    // resolved one after another.
+    const float bounce = 0.5f * (1.0f + m_collisions.restitution);
+    const float separation = 0.5f * m_collisions.separation;
+    for (size_t k = begin; k < end; k++)
+    {
+        const size_t i = m_grid.item(k);
+        const size_t slot = m_first + i;
+        Vector2f push(0.0f, 0.0f);
+        Vector2f impulse(0.0f, 0.0f);
+        if (m_ttl[slot] > 0.0f)
+        {
+            const Vector2f p = m_center[slot];
+            const Vector2f v(m_vx[slot], m_vy[slot]);
+            const float ri = radius(i);
+            m_grid.forEachWithin(p, ri + m_maxRadius, [&](uint32_t j) {
+                const size_t other = m_first + j;
+                if (j == i || m_ttl[other] <= 0.0f)
+                {
+                    return;
+                }
+                const float reach = ri + radius(j);
+                const Vector2f d = m_center[other] - p;
+                const float distance2 = d.x * d.x + d.y * d.y;
+                if (distance2 >= reach * reach)
+                {
+                    return;
+                }
+                // Particles spawned by one click start on the same spot: part
+                // them along a direction of their own, opposite for each
+                const float distance = sqrt(distance2);
+                Vector2f n;
+                if (distance > 0.0f)
+                {
+                    n = d / distance;
+                }
+                else
+                {
+                    const float a = 2.3999632f * static_cast<float>(min<size_t>(i, j));
+                    n = Vector2f(cos(a), sin(a)) * (j > i ? 1.0f : -1.0f);
+                }
+                push -= n * ((reach - distance) * separation);
+                const float closing = (v.x - m_vx[other]) * n.x + (v.y - m_vy[other]) * n.y;
+                if (closing > 0.0f)
+                {
+                    impulse -= n * (closing * bounce);
+                }
+            });
+        }
+        m_pushes[i] = push;
+        m_impulses[i] = impulse;
+    }
+}
+
+void ParticleSystem::applyCollisions(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        const size_t slot = m_first + i;
+        m_center[slot] += m_pushes[i];
+        m_vx[slot] += m_impulses[i].x;
+        m_vy[slot] += m_impulses[i].y;
+    }
+}
+
+size_t ParticleSystem::updateRange(size_t begin, size_t end, float dt)
+{
+    // Particles that were already expired coming into this frame are marked for
+    // removal. Like Particle::update, a particle whose TTL runs out this frame is
+    // not moved but is kept to be drawn once more.
+    // Rotating and scaling about the center, then moving the center, is the
+    // same as Particle::update's rotate, scale and translate of every vertex.
+    // Particles that left the viewport for good are dropped right away: they
+    // would not be drawn anyway.
+    const bool retire = m_retireOffscreen && !m_collisions.enabled && m_viewport.width > 0.0f;
+    size_t dropped = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        m_keep[i] = m_ttl[i] > 0.0f;
+        if (!m_keep[i])
+        {
+            dropped++;
+            continue;
+        }
+
+        m_previousCenter[i] = m_center[i];
+        m_previousAngle[i] = m_angle[i];
+        m_previousScale[i] = m_scale[i];
+
+        m_ttl[i] -= dt;
+        if (m_ttl[i] > 0)
+        {
+            float dx = m_vx[i] * dt;
+            m_vy[i] -= G * dt;
+            float dy = m_vy[i] * dt;
+
+            m_angle[i] += dt * m_radiansPerSec[i];
+            m_scale[i] *= SCALE;
+            m_center[i].x += dx;
+            m_center[i].y += dy;
+        }
+        if (retire && leftViewport(i))
+        {
+            m_keep[i] = false;
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+bool ParticleSystem::leftViewport(size_t i) const
+{
+    const float r = m_radius[i] * static_cast<float>(m_previousScale[i]);
+    const float highest = max(m_center[i].y, m_previousCenter[i].y);
+    const float leftmost = min(m_center[i].x, m_previousCenter[i].x);
+    const float rightmost = max(m_center[i].x, m_previousCenter[i].x);
+    return (highest + r < m_viewport.top && m_vy[i] <= 0.0f)
+        || (rightmost + r < m_viewport.left && m_vx[i] <= 0.0f)
+        || (leftmost - r > m_viewport.left + m_viewport.width && m_vx[i] >= 0.0f);
+}
+
+void ParticleSystem::compact()
+{
+    // Retire the run of expired particles at the head: no particle moves, only
+    // their vertex blocks go back to the free lists
+    const size_t end = m_ttl.size();
+    size_t retired = 0;
+    while (m_first < end && !m_keep[m_first])
+    {
+        m_retiredOffscreen += m_ttl[m_first] > 0.0f;
+        releaseVertices(m_first);
+        m_first++;
+        retired++;
+    }
+
+    // Anything that expired out of spawn order, e.g. off screen, is packed out
+    // in one stable pass. Only the per-particle arrays move; the vertex blocks
+    // stay put. Most frames nothing did, and the pass is skipped.
+    if (retired < m_dropped)
+    {
+        size_t live = m_first;
+        for (size_t i = m_first; i < end; i++)
+        {
+            if (!m_keep[i])
+            {
+                // Only particles that left the viewport go with TTL to spare
+                m_retiredOffscreen += m_ttl[i] > 0.0f;
+                releaseVertices(i);
+                continue;
+            }
+            if (live != i)
+            {
+                moveParticle(live, i);
+            }
+            live++;
+        }
+        truncate(live);
+    }
+    m_dropped = 0;
+
+    if (m_first == m_ttl.size())
+    {
+        // Empty: start over from the beginning of every buffer
+        truncate(0);
+        m_first = 0;
+        resetVertices();
+        return;
+    }
+
+    // Reuse the retired slots once they outnumber the live particles, so the
+    // cost of moving the survivors is paid for by the retirements behind it
+    if (m_first >= size())
+    {
+        rebase();
+    }
+}
+
+size_t ParticleSystem::retireOldest(size_t count)
+{
+    count = std::min(count, size());
+    for (size_t k = 0; k < count; k++)
+    {
+        releaseVertices(m_first);
+        m_first++;
+    }
+    if (m_first == m_ttl.size())
+    {
+        truncate(0);
+        m_first = 0;
+        resetVertices();
+    }
+    else if (m_first >= size())
+    {
+        rebase();
+    }
+    return count;
+}
+
+void ParticleSystem::draw(RenderTarget& target, RenderStates states) const
+{
+    submit(target, states, buildStream());
+}
+
+void ParticleSystem::submit(RenderTarget& target, RenderStates states, size_t streamSize) const
+{
+    if (streamSize == 0)
+    {
+        return;
+    }
+
+#ifdef PARTICLES_HAS_VERTEX_BUFFER
+    if (VertexBuffer::isAvailable())
+    {
+        unique_ptr<VertexBuffer>& buffer = m_streamBuffer.buffer;
+        if (!buffer)
+        {
+            buffer.reset(new VertexBuffer(Triangles, VertexBuffer::Stream));
+        }
+        if (buffer->getVertexCount() < m_stream.size())
+        {
+            buffer->create(m_stream.size());
+        }
+        buffer->update(m_stream.data(), streamSize, 0);
+        target.draw(*buffer, 0, streamSize, states);
+        return;
+    }
+#endif
+    target.draw(m_stream.data(), streamSize, Triangles, states);
+}
+
+size_t ParticleSystem::buildStream(float alpha) const
+{
+    const bool interpolate = alpha < 1.0f;
+    // A fan of 1 + n vertices is n - 1 triangles; room for all of them
+    const size_t maxStreamSize = 3 * (m_liveVertices - min(m_liveVertices, size()));
+    if (maxStreamSize > m_stream.size())
+    {
+        m_stream.resize(max(maxStreamSize, 2 * m_stream.size()));
+    }
+
+    const bool cull = m_viewport.width > 0.0f;
+    m_culled = 0;
+    m_drawnVertices = 0;
+    m_lodSkipped = 0;
+    Vertex* out = m_stream.data();
+    for (size_t i = m_first; i < m_ttl.size(); i++)
+    {
+        const int count = m_vertexCount[i];
+        if (count < 2)
+        {
+            continue;
+        }
+        const Vector2f position = interpolate ? center(i, alpha) : m_center[i];
+        if (cull && !inViewport(i, position))
+        {
+            m_culled++;
+            continue;
+        }
+        const Color color2 = m_color2[i];
+        const ParticleScalar* x = localX(i);
+        const ParticleScalar* y = localY(i);
+
+        // Each vertex is posed once, right where it is written
+        double angle = m_angle[i];
+        double scale = m_scale[i];
+        if (interpolate)
+        {
+            angle = m_previousAngle[i] + (m_angle[i] - m_previousAngle[i]) * alpha;
+            scale = m_previousScale[i] + (m_scale[i] - m_previousScale[i]) * alpha;
+        }
+        const ParticleTransform t = ParticleTransform::pose(angle, scale, position.x, position.y);
+        const Vertex center(position, m_color1[i]);
+        auto world = [&t, x, y](int j) {
+            return sf::Vector2f(static_cast<float>(t.m00 * x[j] + t.m01 * y[j] + t.m02),
+                                static_cast<float>(t.m10 * x[j] + t.m11 * y[j] + t.m12));
+        };
+
+        // Every stride-th vertex, and always the last one, which closes the outline
+        const int stride = m_lod.enabled ? lodStride(count, m_radius[i] * static_cast<float>(scale)) : 1;
+        sf::Vector2f previous = world(0);
+        int drawn = 1;
+        for (int j = stride; ; j += stride)
+        {
+            j = min(j, count - 1);
+            const sf::Vector2f current = world(j);
+            *out++ = center;
+            *out++ = Vertex(previous, color2);
+            *out++ = Vertex(current, color2);
+            previous = current;
+            drawn++;
+            if (j == count - 1)
+            {
+                break;
+            }
+        }
+        m_drawnVertices += drawn;
+        m_lodSkipped += count - drawn;
+    }
+    return static_cast<size_t>(out - m_stream.data());
+}
+
+int ParticleSystem::lodStride(int count, float radius) const
+{
+    // Corners the outline needs for edges of about pixelsPerEdge: double the
+    // stride while half as many corners would still do
+    const int edges = count - 1;
+    const float wanted = max(static_cast<float>(m_lod.minCorners),
+                             6.2831853f * radius * m_lod.pixelsPerUnit / m_lod.pixelsPerEdge);
+    int stride = 1;
+    while ((edges + 2 * stride - 1) / (2 * stride) >= wanted)
+    {
+        stride *= 2;
+    }
+    return stride;
+}
+
+void ParticleSystem::worldVertices(size_t i, ParticleScalar* x, ParticleScalar* y) const
+{
+    const size_t slot = m_first + i;
+    const int count = m_vertexCount[slot];
+    std::copy(localX(slot), localX(slot) + count, x);
+    std::copy(localY(slot), localY(slot) + count, y);
+    VertexKernels::transform(pose(slot), x, y, count);
+}
+
+void ParticleSystem::reserve(size_t particles, size_t vertices)
+{
+    // Retired slots wait at the head until they outnumber the live particles,
+    // so the arrays hold up to twice the live count
+    particles *= 2;
+    m_center.reserve(particles);
+    m_vx.reserve(particles);
+    m_vy.reserve(particles);
+    m_ttl.reserve(particles);
+    m_radiansPerSec.reserve(particles);
+    m_angle.reserve(particles);
+    m_scale.reserve(particles);
+    m_previousCenter.reserve(particles);
+    m_previousAngle.reserve(particles);
+    m_previousScale.reserve(particles);
+    m_color1.reserve(particles);
+    m_color2.reserve(particles);
+    m_vertexOffset.reserve(particles);
+    m_vertexCount.reserve(particles);
+    m_sharedShape.reserve(particles);
+    m_radius.reserve(particles);
+    m_keep.reserve(particles);
+    if (vertices > m_vertexX.size())
+    {
+        growVertices(vertices - m_vertexTop);
+    }
+}
+
+namespace
+{
+    // dst = the live part of src, from slot first on
+    template <typename T>
+    void copyLive(const vector<T>& src, size_t first, vector<T>& dst)
+    {
+        dst.assign(src.begin() + first, src.end());
+    }
+}
+
+void ParticleSystem::copyStateTo(ParticleSystem& dst) const
+{
+    // Only the live slots, rebased to slot 0 in dst
+    copyLive(m_center, m_first, dst.m_center);
+    copyLive(m_vx, m_first, dst.m_vx);
+    copyLive(m_vy, m_first, dst.m_vy);
+    copyLive(m_ttl, m_first, dst.m_ttl);
+    copyLive(m_radiansPerSec, m_first, dst.m_radiansPerSec);
+    copyLive(m_angle, m_first, dst.m_angle);
+    copyLive(m_scale, m_first, dst.m_scale);
+    copyLive(m_previousCenter, m_first, dst.m_previousCenter);
+    copyLive(m_previousAngle, m_first, dst.m_previousAngle);
+    copyLive(m_previousScale, m_first, dst.m_previousScale);
+    copyLive(m_color1, m_first, dst.m_color1);
+    copyLive(m_color2, m_first, dst.m_color2);
+    copyLive(m_vertexOffset, m_first, dst.m_vertexOffset);
+    copyLive(m_vertexCount, m_first, dst.m_vertexCount);
+    copyLive(m_sharedShape, m_first, dst.m_sharedShape);
+    copyLive(m_radius, m_first, dst.m_radius);
+    dst.m_first = 0;
+    dst.m_maxRadius = m_maxRadius;
+    dst.m_collisions = m_collisions;
+
+    // The pool up to its top: live blocks and free ones alike
+    dst.m_vertexX.assign(m_vertexX.begin(), m_vertexX.begin() + m_vertexTop);
+    dst.m_vertexY.assign(m_vertexY.begin(), m_vertexY.begin() + m_vertexTop);
+    dst.m_vertexTop = m_vertexTop;
+    dst.m_freeVertices = m_freeVertices;
+    dst.m_liveVertices = m_liveVertices;
+    // Prebuilt shapes are only ever added, so a pool of the same size is the same pool
+    if (dst.m_shapes.poolSize() != m_shapes.poolSize())
+    {
+        dst.m_shapes = m_shapes;
+    }
+}
+
+void ParticleSystem::swapState(ParticleSystem& other)
+{
+    std::swap(m_first, other.m_first);
+    m_center.swap(other.m_center);
+    m_vx.swap(other.m_vx);
+    m_vy.swap(other.m_vy);
+    m_ttl.swap(other.m_ttl);
+    m_radiansPerSec.swap(other.m_radiansPerSec);
+    m_angle.swap(other.m_angle);
+    m_scale.swap(other.m_scale);
+    m_previousCenter.swap(other.m_previousCenter);
+    m_previousAngle.swap(other.m_previousAngle);
+    m_previousScale.swap(other.m_previousScale);
+    m_color1.swap(other.m_color1);
+    m_color2.swap(other.m_color2);
+    m_vertexOffset.swap(other.m_vertexOffset);
+    m_vertexCount.swap(other.m_vertexCount);
+    m_sharedShape.swap(other.m_sharedShape);
+    m_radius.swap(other.m_radius);
+    std::swap(m_maxRadius, other.m_maxRadius);
+    std::swap(m_collisions, other.m_collisions);
+    m_vertexX.swap(other.m_vertexX);
+    m_vertexY.swap(other.m_vertexY);
+    std::swap(m_vertexTop, other.m_vertexTop);
+    m_freeVertices.swap(other.m_freeVertices);
+    std::swap(m_liveVertices, other.m_liveVertices);
+    m_keep.swap(other.m_keep);
+    std::swap(m_dropped, other.m_dropped);
+    std::swap(m_shapes, other.m_shapes);
+}
+
+void ParticleSystem::writeState(ByteWriter& out) const
+{
+    out.array(m_center, m_first);
+    out.array(m_vx, m_first);
+    out.array(m_vy, m_first);
+    out.array(m_ttl, m_first);
+    out.array(m_radiansPerSec, m_first);
+    out.array(m_angle, m_first);
+    out.array(m_scale, m_first);
+    out.array(m_previousCenter, m_first);
+    out.array(m_previousAngle, m_first);
+    out.array(m_previousScale, m_first);
+    out.array(m_color1, m_first);
+    out.array(m_color2, m_first);
+    out.array(m_vertexOffset, m_first);
+    out.array(m_vertexCount, m_first);
+    out.array(m_sharedShape, m_first);
+    out.array(m_radius, m_first);
+    out.pod(m_maxRadius);
+
+    out.pod(static_cast<int32_t>(m_vertexTop));
+    out.bytes(m_vertexX.data(), m_vertexTop * sizeof(ParticleScalar));
+    out.bytes(m_vertexY.data(), m_vertexTop * sizeof(ParticleScalar));
+    out.array(m_freeVertices);
+    out.pod(static_cast<uint64_t>(m_liveVertices));
+    m_shapes.writePool(out);
+}
+
+bool ParticleSystem::readState(ByteReader& in)
+{
+    m_first = 0;
+    bool ok = in.array(m_center) && in.array(m_vx) && in.array(m_vy) && in.array(m_ttl)
+        && in.array(m_radiansPerSec) && in.array(m_angle) && in.array(m_scale)
+        && in.array(m_previousCenter) && in.array(m_previousAngle) && in.array(m_previousScale)
+        && in.array(m_color1) && in.array(m_color2) && in.array(m_vertexOffset) && in.array(m_vertexCount)
+        && in.array(m_sharedShape) && in.array(m_radius) && in.pod(m_maxRadius);
+
+    int32_t top = 0;
+    uint64_t liveVertices = 0;
+    ok = ok && in.pod(top) && top >= 0 && static_cast<size_t>(top) <= in.remaining() / (2 * sizeof(ParticleScalar));
+    if (ok)
+    {
+        m_vertexTop = 0;
+        if (static_cast<size_t>(top) > m_vertexX.size())
+        {
+            growVertices(static_cast<size_t>(top));
+        }
+        m_vertexTop = top;
+        ok = in.bytes(m_vertexX.data(), top * sizeof(ParticleScalar)) && in.bytes(m_vertexY.data(), top * sizeof(ParticleScalar));
+    }
+    ok = ok && in.array(m_freeVertices) && in.pod(liveVertices) && m_shapes.readPool(in);
+    m_liveVertices = static_cast<size_t>(liveVertices);
+
+    // Every array one entry per particle, every shape where it says it is
+    const size_t count = m_ttl.size();
+    ok = ok && m_center.size() == count && m_vx.size() == count && m_vy.size() == count
+        && m_radiansPerSec.size() == count && m_angle.size() == count && m_scale.size() == count
+        && m_previousCenter.size() == count && m_previousAngle.size() == count && m_previousScale.size() == count
+        && m_color1.size() == count && m_color2.size() == count && m_vertexOffset.size() == count
+        && m_vertexCount.size() == count && m_sharedShape.size() == count && m_radius.size() == count;
+    // and at least 2 vertices: buildStream sizes its stream for fans of 2 or more.
+    // No two blocks of the pool, live or free, may overlap: releasing one twice
+    // would link a free list to itself and hand the same vertices out again.
+    vector<bool> used(ok ? static_cast<size_t>(m_vertexTop) : 0, false);
+    auto claim = [&used](int offset, int points) {
+        for (int j = offset; j < offset + points; j++)
+        {
+            if (used[j])
+            {
+                return false;
+            }
+            used[j] = true;
+        }
+        return true;
+    };
+    size_t vertices = 0;
+    for (size_t i = 0; i < count && ok; i++)
+    {
+        const int offset = m_vertexOffset[i];
+        const int points = m_vertexCount[i];
+        vertices += points;
+        ok = points >= 2
+            && (m_sharedShape[i] ? offset >= 0 && static_cast<size_t>(offset) < m_shapes.poolSize() && points == m_shapes.shapePoints(offset)
+                                 : offset >= 0 && offset <= m_vertexTop - points && claim(offset, points));
+    }
+    ok = ok && vertices == m_liveVertices;
+    // Free blocks link through their first vertex; every link must lead to a
+    // block inside the pool that no other block overlaps, so no list can loop
+    for (size_t n = 1; n < m_freeVertices.size() && ok; n++)
+    {
+        for (int link = m_freeVertices[n]; ok && link != -1;)
+        {
+            ok = link >= 0 && static_cast<size_t>(link) + n <= static_cast<size_t>(m_vertexTop) && claim(link, static_cast<int>(n));
+            link = ok ? nextFree(link) : -1;
+        }
+    }
+    ok = ok && (m_freeVertices.empty() || m_freeVertices[0] == -1);
+    if (!ok)
+    {
+        truncate(0);
+        resetVertices();
+        m_liveVertices = 0;
+    }
+    return ok;
+}
+
+void ParticleSystem::clear()
+{
+    truncate(0);
+    m_first = 0;
+    resetVertices();
+    m_liveVertices = 0;
+}
+
+unsigned long long ParticleSystem::checksum() const
+{
+    // FNV-1a over the raw bytes of the state that changes from frame to frame.
+    // The shapes never change, so the pose stands in for the vertices.
+    unsigned long long hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, size_t bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t k = 0; k < bytes; k++)
+        {
+            hash = (hash ^ p[k]) * 1099511628211ULL;
+        }
+    };
+    for (size_t i = m_first; i < m_ttl.size(); i++)
+    {
+        mix(&m_center[i], sizeof(Vector2f));
+        mix(&m_vx[i], sizeof(float));
+        mix(&m_vy[i], sizeof(float));
+        mix(&m_ttl[i], sizeof(float));
+        mix(&m_angle[i], sizeof(double));
+        mix(&m_scale[i], sizeof(double));
+    }
+    return hash;
+}
+
+void ParticleSystem::moveParticle(size_t dst, size_t src)
+{
+    m_center[dst] = m_center[src];
+    m_vx[dst] = m_vx[src];
+    m_vy[dst] = m_vy[src];
+    m_ttl[dst] = m_ttl[src];
+    m_radiansPerSec[dst] = m_radiansPerSec[src];
+    m_angle[dst] = m_angle[src];
+    m_scale[dst] = m_scale[src];
+    m_previousCenter[dst] = m_previousCenter[src];
+    m_previousAngle[dst] = m_previousAngle[src];
+    m_previousScale[dst] = m_previousScale[src];
+    m_color1[dst] = m_color1[src];
+    m_color2[dst] = m_color2[src];
+    m_vertexOffset[dst] = m_vertexOffset[src];
+    m_vertexCount[dst] = m_vertexCount[src];
+    m_sharedShape[dst] = m_sharedShape[src];
+    m_radius[dst] = m_radius[src];
+}
+
+void ParticleSystem::rebase()
+{
+    const size_t live = size();
+    for (size_t i = 0; i < live; i++)
+    {
+        moveParticle(i, m_first + i);
+    }
+    m_first = 0;
+    truncate(live);
+}
+
+void ParticleSystem::truncate(size_t particles)
+{
+    // resize never releases capacity, so steady-state frames do not reallocate
+    m_center.resize(particles);
+    m_vx.resize(particles);
+    m_vy.resize(particles);
+    m_ttl.resize(particles);
+    m_radiansPerSec.resize(particles);
+    m_angle.resize(particles);
+    m_scale.resize(particles);
+    m_previousCenter.resize(particles);
+    m_previousAngle.resize(particles);
+    m_previousScale.resize(particles);
+    m_color1.resize(particles);
+    m_color2.resize(particles);
+    m_vertexOffset.resize(particles);
+    m_vertexCount.resize(particles);
+    m_sharedShape.resize(particles);
+    m_radius.resize(particles);
+}
+
+int ParticleSystem::allocateVertices(int count)
+{
+    if (count >= static_cast<int>(m_freeVertices.size()))
+    {
+        m_freeVertices.resize(count + 1, -1);
+    }
+
+    // Reuse the last block freed with this many vertices
+    const int offset = m_freeVertices[count];
+    if (offset >= 0)
+    {
+        m_freeVertices[count] = nextFree(offset);
+        return offset;
+    }
+
+    if (m_vertexTop + count > static_cast<int>(m_vertexX.size()))
+    {
+        growVertices(static_cast<size_t>(count));
+    }
+    m_vertexTop += count;
+    return m_vertexTop - count;
+}
+
+void ParticleSystem::releaseVertices(size_t slot)
+{
+    const int offset = m_vertexOffset[slot];
+    const int count = m_vertexCount[slot];
+    m_liveVertices -= count;
+    if (!m_sharedShape[slot] && count > 0)
+    {
+        setNextFree(offset, m_freeVertices[count]);
+        m_freeVertices[count] = offset;
+    }
+}
+
+void ParticleSystem::resetVertices()
+{
+    m_vertexTop = 0;
+    std::fill(m_freeVertices.begin(), m_freeVertices.end(), -1);
+}
+
+void ParticleSystem::growVertices(size_t extra)
+{
+    // Geometric growth, like vector, so reallocation is rare. Blocks keep their
+    // offsets, so nothing needs repacking.
+    const size_t needed = m_vertexTop + extra;
+    const size_t capacity = std::max(needed, std::max<size_t>(2 * m_vertexX.size(), 1024));
+    m_vertexX.resize(capacity);
+    m_vertexY.resize(capacity);
+}
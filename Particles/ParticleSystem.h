@@ -0,0 +1,356 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "ByteStream.h"
+#include "Particle.h"
+#include "ShapeLibrary.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+using namespace sf;
+using namespace std;
+
+// How particles bump into each other, when they do
+struct CollisionConfig
+{
+    bool enabled = false;
+    float restitution = 0.5f; // Share of the closing speed kept after a bounce
+    float separation = 0.5f;  // Share of an overlap pushed apart per update
+};
+
+// Level of detail: how much of a particle's outline to draw at its size on
+// screen
+struct LodConfig
+{
+    bool enabled = false;
+    float pixelsPerEdge = 4.0f; // Outline edges shorter than this are merged
+    int minCorners = 4;         // Never fewer corners than this; 4 is a quad
+    float pixelsPerUnit = 1.0f; // Zoom of the view: Engine draws a unit as a pixel
+};
+
+// Structure-of-arrays store for every live particle.
+// Per-particle state lives in parallel arrays indexed by slot, and the vertices
+// of all particles share one flat buffer addressed by (offset, count).
+//
+// A particle's shape never changes, only where it is: the vertices are stored
+// once, in coordinates local to the particle's center, and each particle keeps
+// a pose (center, accumulated rotation and accumulated scale). Updating a
+// particle costs the same whatever its vertex count; world coordinates are only
+// computed when something needs them, straight into the draw stream.
+// Shapes either live in the system's own vertex pool, one block per particle,
+// or are prebuilt shapes of the system's ShapeLibrary, shared by reference.
+// The pose before the last update is kept too, so drawing can interpolate
+// between the last two updates of a fixed-timestep simulation.
+//
+// Given the viewport, drawing skips every particle whose bounding circle is
+// outside it before touching its vertices, and updates can retire particles
+// that can never come back into view: below it and falling, or beside it and
+// moving away. Gravity only ever pulls down and shapes only shrink, so those
+// particles are gone for good.
+//
+// With level of detail on, a particle drawn small skips outline vertices: it
+// keeps every 2nd, 4th, ... vertex of its shape, plus the last one. The subset
+// only depends on the vertex count and the level, so it does not shimmer from
+// frame to frame, and each level's vertices are a subset of the level above,
+// so dropping a level only removes corners. Skipped vertices are never posed.
+//
+// With collisions on, each update indexes the particles in a spatial grid and
+// resolves overlapping pairs, every particle taken as the circle around its
+// vertices. Every particle sums its own response from the state before the
+// pass, so the pass runs in parallel and gives the same result on any number
+// of threads.
+//
+// Particles are kept in spawn order. With a fixed TTL that is also expiry order,
+// so the expired particles are always a run at the head of the arrays: they are
+// retired by moving the head index forward, without touching the survivors.
+// Particles that expire out of order are removed by one stable pass over the
+// per-particle arrays.
+//
+// The vertex buffer is a pool of blocks. A retired particle's block goes on a
+// free list for its vertex count and is handed to the next particle spawned
+// with that count, so once the pool has grown to the peak load, spawning and
+// retiring particles allocates nothing.
+//
+// Drawing converts every particle's fan into a plain triangle list in one
+// persistent vertex stream and submits the whole system in a single draw call.
+class ParticleSystem : public Drawable
+{
+public:
+    ParticleSystem();
+
+    // Copy a newly constructed particle into the store
+    void add(const Particle& particle);
+
+    // Spawn a particle straight into the store, without building a Particle.
+    // Draws the same numbers from random as Particle's constructor does.
+    void spawn(Vector2u targetSize, int numPoints, Vector2i mouseClickPosition, Random& random);
+
+    // Spawn a particle the way an emitter is configured to
+    void spawn(Vector2u targetSize, const EmitterConfig& emitter, Vector2i mouseClickPosition, Random& random);
+
+    ShapeLibrary& shapes() { return m_shapes; }
+
+    // Advance every live particle's pose by dt and drop the ones whose TTL
+    // expired. With a pool the particles are updated in parallel chunks; the
+    // result is the same for any number of threads.
+    void update(float dt, ThreadPool* pool = nullptr);
+
+    // The two halves of update, for callers that time them separately:
+    // advance marks the particles that expired, retireExpired drops them
+    void advance(float dt, ThreadPool* pool = nullptr);
+    void retireExpired() { compact(); }
+
+    // Retire the count oldest live particles, whatever their TTL, to shed
+    // load. They are a run at the head, so this moves nothing. Call it
+    // between updates, not between advance and retireExpired. Returns how
+    // many were retired.
+    size_t retireOldest(size_t count);
+
+    // Opt-in particle-particle collisions, applied by advance
+    void setCollisions(const CollisionConfig& collisions) { m_collisions = collisions; }
+    const CollisionConfig& getCollisions() const { return m_collisions; }
+
+    // Index the live particles' centers for neighbor and range queries. The
+    // grid reports live indices (0 is the oldest), valid until the particles
+    // next change. Collisions index them as part of advance.
+    void indexParticles(ThreadPool* pool = nullptr);
+    const SpatialGrid& grid() const { return m_grid; }
+
+    // Center of live particle i
+    Vector2f position(size_t i) const { return m_center[m_first + i]; }
+
+    // Radius of the circle around live particle i's vertices, at its current scale
+    float radius(size_t i) const { return m_radius[m_first + i] * static_cast<float>(m_scale[m_first + i]); }
+
+    // Area to draw, in Cartesian coordinates (left, bottom, width, height).
+    // Particles outside it are culled; an empty viewport, the default, draws all.
+    // It stays with this system when states are copied or swapped.
+    void setViewport(const FloatRect& viewport) { m_viewport = viewport; }
+    const FloatRect& getViewport() const { return m_viewport; }
+
+    // Also drop particles, during update, once they can never enter the
+    // viewport again. Not done with collisions on, which can throw a particle
+    // back up.
+    void setRetireOffscreen(bool retire) { m_retireOffscreen = retire; }
+    bool getRetireOffscreen() const { return m_retireOffscreen; }
+
+    // Draw small particles with fewer vertices
+    void setLod(const LodConfig& lod) { m_lod = lod; }
+    const LodConfig& getLod() const { return m_lod; }
+
+    // Particles the last buildStream culled
+    size_t culledCount() const { return m_culled; }
+
+    // Particles retired off screen so far
+    size_t retiredOffscreenCount() const { return m_retiredOffscreen; }
+
+    // Shape vertices the last buildStream posed, and the ones it skipped for
+    // level of detail (culled particles count in neither)
+    size_t drawnVertices() const { return m_drawnVertices; }
+    size_t lodSkippedVertices() const { return m_lodSkipped; }
+
+    // Vertices are submitted in Cartesian coordinates: states.transform must map
+    // them to pixels, e.g. with cartesianToPixel
+    virtual void draw(RenderTarget& target, RenderStates states) const override;
+
+    // Fill the triangle list draw submits, without drawing it.
+    // alpha blends each pose from before the last update (0) to the current one (1).
+    // Returns the number of vertices; getStream() points at them.
+    size_t buildStream(float alpha = 1.0f) const;
+    const Vertex* getStream() const { return m_stream.data(); }
+
+    // The other half of draw: submit the first streamSize vertices built by buildStream
+    void submit(RenderTarget& target, RenderStates states, size_t streamSize) const;
+
+    // World coordinates of live particle i's vertices (0 is the oldest),
+    // written to x and y, which must have room for particleVertexCount(i)
+    void worldVertices(size_t i, ParticleScalar* x, ParticleScalar* y) const;
+    int particleVertexCount(size_t i) const { return m_vertexCount[m_first + i]; }
+
+    // Copy the simulated state, not the draw stream, into dst for drawing
+    // elsewhere. dst reuses its capacity, so once it has grown this does not
+    // allocate.
+    void copyStateTo(ParticleSystem& dst) const;
+
+    // Exchange simulated states with other in O(1); the draw streams stay put
+    void swapState(ParticleSystem& other);
+
+    // Serialize the simulated state, as copyStateTo copies it. readState
+    // replaces this system's state and returns false, leaving it empty, if
+    // the data is not a valid state.
+    void writeState(ByteWriter& out) const;
+    bool readState(ByteReader& in);
+
+    // Preallocate room for the given number of particles and vertices: with
+    // the high-water mark of a run, its steady-state frames do not allocate
+    void reserve(size_t particles, size_t vertices);
+    void clear();
+
+    size_t size() const { return m_ttl.size() - m_first; }
+    size_t vertexCount() const { return m_liveVertices; }
+
+    // Vertices the pool has handed out so far, live or waiting on a free list
+    size_t vertexCapacity() const { return static_cast<size_t>(m_vertexTop); }
+
+    // Hash of the simulated state, for comparing runs
+    unsigned long long checksum() const;
+
+private:
+    static const size_t kUpdateGrain = 512; // Particles per parallel update chunk
+
+    // Per-particle state. Slots before m_first are retired and wait to be reused;
+    // the live particles are slots m_first .. size - 1
+    size_t m_first;
+    vector<Vector2f> m_center;        // Particle centers
+    vector<float> m_vx;               // Horizontal velocities
+    vector<float> m_vy;               // Vertical velocities
+    vector<float> m_ttl;              // Remaining lives
+    vector<float> m_radiansPerSec;    // Rotation speeds
+    vector<double> m_angle;           // Rotation since spawn, radians
+    vector<double> m_scale;           // Scale since spawn
+    vector<Vector2f> m_previousCenter; // Pose before the last update
+    vector<double> m_previousAngle;
+    vector<double> m_previousScale;
+    vector<Color> m_color1;           // Center colors
+    vector<Color> m_color2;           // Vertex colors
+    vector<int> m_vertexOffset;       // First vertex in the pool, or the prebuilt shape's id
+    vector<int> m_vertexCount;        // Number of vertices
+    vector<char> m_sharedShape;       // The shape is a prebuilt one from m_shapes
+    vector<float> m_radius;           // Farthest vertex from the center, at spawn
+    float m_maxRadius;                // Largest m_radius ever pushed, for query ranges
+
+    // Shared vertex pool, every particle's shape relative to its center.
+    // Blocks below m_vertexTop are in use or on a free list; the rest is unused.
+    // A free block stores the offset of the next free block of the same size in
+    // the bits of its first x coordinate, so the free lists need no memory of
+    // their own. Coordinates are ParticleScalar, double or float (Precision.h).
+    vector<ParticleScalar> m_vertexX;
+    vector<ParticleScalar> m_vertexY;
+    int m_vertexTop;                  // Where the next new block goes
+    vector<int> m_freeVertices;       // First free block per vertex count, -1 if none
+    size_t m_liveVertices;            // Vertices that belong to live particles
+
+    vector<char> m_keep;              // Scratch: particle survives this frame's compaction
+    size_t m_dropped;                 // Particles the last advance marked to drop
+
+    FloatRect m_viewport;
+    bool m_retireOffscreen;
+    mutable size_t m_culled;
+    LodConfig m_lod;
+    mutable size_t m_drawnVertices;
+    mutable size_t m_lodSkipped;
+    size_t m_retiredOffscreen;
+
+    CollisionConfig m_collisions;
+    SpatialGrid m_grid;               // Live particle centers, as of the last indexParticles
+    vector<Vector2f> m_pushes;        // Scratch: collision response per live particle
+    vector<Vector2f> m_impulses;
+
+    ShapeLibrary m_shapes;            // Direction tables and prebuilt shapes
+
+    // Triangle list built by draw. Both only ever grow, geometrically, so a
+    // steady particle count renders without reallocating
+    mutable vector<Vertex> m_stream;
+#if SFML_VERSION_MAJOR > 2 || (SFML_VERSION_MAJOR == 2 && SFML_VERSION_MINOR >= 5)
+#define PARTICLES_HAS_VERTEX_BUFFER 1
+    // GPU copy of m_stream, when supported. Created on first draw: a VertexBuffer
+    // needs an OpenGL context, which a headless engine does not have.
+    // A copied ParticleSystem starts without one.
+    struct StreamBuffer
+    {
+        unique_ptr<VertexBuffer> buffer;
+        StreamBuffer() {}
+        StreamBuffer(const StreamBuffer&) {}
+        StreamBuffer& operator=(const StreamBuffer&) { buffer.reset(); return *this; }
+    };
+    mutable StreamBuffer m_streamBuffer;
+#endif
+
+    // Advance the poses of particles [begin, end); returns how many of them
+    // are marked to drop
+    size_t updateRange(size_t begin, size_t end, float dt);
+
+    // Resolve collisions: work out the response of the particles stored
+    // [begin, end) in the grid, then apply it to live particles [begin, end)
+    void collide(ThreadPool* pool);
+    void collideRange(size_t begin, size_t end);
+    void applyCollisions(size_t begin, size_t end);
+
+    // Maps slot i's local vertices to the world
+    ParticleTransform pose(size_t i) const
+    {
+        return ParticleTransform::pose(m_angle[i], m_scale[i], m_center[i].x, m_center[i].y);
+    }
+
+    // Slot i's bounding circle, centered at position, touches the viewport.
+    // The scale before the last update is the larger one.
+    bool inViewport(size_t i, Vector2f position) const
+    {
+        const float r = m_radius[i] * static_cast<float>(m_previousScale[i]);
+        return position.x + r >= m_viewport.left && position.x - r <= m_viewport.left + m_viewport.width
+            && position.y + r >= m_viewport.top && position.y - r <= m_viewport.top + m_viewport.height;
+    }
+
+    // Slot i is out of the viewport, before and after its last update, and
+    // moving away from it
+    bool leftViewport(size_t i) const;
+
+    // Stride through the outline of a particle with count vertices and the
+    // given radius in units: 1 draws every vertex
+    int lodStride(int count, float radius) const;
+
+    // Slot i's center, alpha of the way from its previous to its current one
+    Vector2f center(size_t i, float alpha) const
+    {
+        return m_previousCenter[i] + (m_center[i] - m_previousCenter[i]) * alpha;
+    }
+
+    // Slot i's shape, wherever it is stored
+    const ParticleScalar* localX(size_t i) const
+    {
+        return m_sharedShape[i] ? m_shapes.shapeX(m_vertexOffset[i]) : m_vertexX.data() + m_vertexOffset[i];
+    }
+    const ParticleScalar* localY(size_t i) const
+    {
+        return m_sharedShape[i] ? m_shapes.shapeY(m_vertexOffset[i]) : m_vertexY.data() + m_vertexOffset[i];
+    }
+
+    // Make the world coordinates of a new pool block relative to center
+    void toLocal(int offset, int numPoints, Vector2f center);
+
+    // Store a new particle's state; its shape is already in local coordinates
+    void push(const ParticleSpawn& spawn, float ttl, double angle, int offset, int numPoints, bool shared);
+
+    // Drop the particles not marked to keep
+    void compact();
+
+    // Move particle src into slot dst (dst <= src); its vertices stay where they are
+    void moveParticle(size_t dst, size_t src);
+
+    // Move the live particles down to slot 0
+    void rebase();
+    void truncate(size_t particles);
+
+    // A block of count vertices, recycled if one is free, returns its offset
+    int allocateVertices(int count);
+
+    // The free block after the one at offset, -1 for none
+    int nextFree(int offset) const
+    {
+        int link;
+        memcpy(&link, &m_vertexX[offset], sizeof(link));
+        return link;
+    }
+    void setNextFree(int offset, int link) { memcpy(&m_vertexX[offset], &link, sizeof(link)); }
+
+    // Give back the vertices of a retired particle: its block goes on the
+    // free list for its size, a prebuilt shape needs nothing
+    void releaseVertices(size_t slot);
+
+    // Forget every block, for when no particle is live
+    void resetVertices();
+
+    // Reallocate the pool with room for at least extra more vertices above the top
+    void growVertices(size_t extra);
+};
@@ -0,0 +1,232 @@
+#include "Tests.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+
+bool testPooledSpawning()
+{
+    // spawn must build the same particle as the constructor, and once a batch
+    // has expired its vertex blocks must be reused by the next batch
+    ParticleSystem spawned, added;
+    Random spawnRandom(3), addRandom(3), counts(11);
+    for (int k = 0; k < 200; k++)
+    {
+        int n = counts.uniformInt(25, 50);
+        spawned.spawn(Vector2u(1920, 1080), n, Vector2i(700, 300), spawnRandom);
+        added.add(Particle(Vector2u(1920, 1080), n, Vector2i(700, 300), addRandom));
+    }
+    bool poolPassed = spawned.checksum() == added.checksum();
+    for (int f = 0; f < 90; f++)
+    {
+        spawned.update(1.0f / 60.0f);
+    }
+    counts.seed(11);
+    for (int k = 0; k < 200; k++)
+    {
+        spawned.spawn(Vector2u(1920, 1080), counts.uniformInt(25, 50), Vector2i(700, 300), spawnRandom);
+    }
+    const size_t poolTop = spawned.vertexCapacity();
+    for (int f = 0; f < 120; f++)
+    {
+        spawned.update(1.0f / 60.0f);
+    }
+    counts.seed(11);
+    for (int k = 0; k < 200; k++)
+    {
+        spawned.spawn(Vector2u(1920, 1080), counts.uniformInt(25, 50), Vector2i(700, 300), spawnRandom);
+    }
+    poolPassed = poolPassed && spawned.size() == 400 && spawned.vertexCapacity() == poolTop;
+    return poolPassed;
+}
+
+bool testPosedShapes()
+{
+    Random poseRandom(5);
+    Particle reference(Vector2u(1920, 1080), 33, Vector2i(1500, 200), poseRandom);
+    ParticleSystem posed;
+    posed.add(reference);
+    for (int f = 0; f < 60; f++)
+    {
+        reference.update(1.0f / 60.0f);
+        posed.update(1.0f / 60.0f);
+    }
+    // A system the updated particle is added to holds its world vertices as they are
+    ParticleSystem updated;
+    updated.add(reference);
+    ParticleScalar posedX[33], posedY[33], updatedX[33], updatedY[33];
+    posed.worldVertices(0, posedX, posedY);
+    updated.worldVertices(0, updatedX, updatedY);
+    bool posePassed = posed.particleVertexCount(0) == 33;
+    for (int j = 0; j < 33 && posePassed; j++)
+    {
+        // The center is a float, so the two paths round differently
+        posePassed = almostEqual(posedX[j], updatedX[j], 0.01) && almostEqual(posedY[j], updatedY[j], 0.01);
+    }
+    return posePassed;
+}
+
+bool testInterpolation()
+{
+    // Drawn at alpha 0, a system shows the pose from before its last update
+    ParticleSystem stepped;
+    Random stepRandom(21);
+    stepped.spawn(Vector2u(1920, 1080), 30, Vector2i(400, 300), stepRandom);
+    stepped.update(1.0f / 60.0f);
+    const size_t streamSize = stepped.buildStream();
+    vector<Vertex> before(stepped.getStream(), stepped.getStream() + streamSize);
+    stepped.update(1.0f / 60.0f);
+    bool stepPassed = stepped.buildStream(0.0f) == before.size();
+    for (size_t j = 0; j < before.size() && stepPassed; j++)
+    {
+        stepPassed = almostEqual(stepped.getStream()[j].position.x, before[j].position.x, 0.001)
+            && almostEqual(stepped.getStream()[j].position.y, before[j].position.y, 0.001);
+    }
+    ParticleSystem copied;
+    stepped.copyStateTo(copied);
+    stepPassed = stepPassed && copied.checksum() == stepped.checksum() && copied.size() == 1;
+    return stepPassed;
+}
+
+bool testCulling()
+{
+    // A particle spawned near the bottom of the screen falls out of view long
+    // before its TTL runs out: culled from then on, or retired right away
+    ParticleSystem culled, retired;
+    culled.setViewport(cartesianViewport(Vector2u(1920, 1080)));
+    retired.setViewport(cartesianViewport(Vector2u(1920, 1080)));
+    retired.setRetireOffscreen(true);
+    ParticleSystem* viewed[] = { &culled, &retired };
+    for (ParticleSystem* system : viewed)
+    {
+        Random viewRandom(4);
+        system->spawn(Vector2u(1920, 1080), 30, Vector2i(960, 1000), viewRandom);
+    }
+    bool cullPassed = culled.buildStream() == 3 * 29 && culled.culledCount() == 0;
+    int fallFrames = 0;
+    while (retired.size() > 0 && fallFrames < 180)
+    {
+        culled.update(1.0f / 60.0f);
+        retired.update(1.0f / 60.0f);
+        fallFrames++;
+    }
+    cullPassed = cullPassed && fallFrames < 180 && retired.retiredOffscreenCount() == 1
+        && culled.size() == 1 && culled.buildStream() == 0 && culled.culledCount() == 1;
+    return cullPassed;
+}
+
+bool testLevelOfDetail()
+{
+    // At the coarsest level a 49-vertex outline keeps every 8th vertex and the
+    // last one, exactly where the full outline has them
+    ParticleSystem detailed;
+    Random detailRandom(6);
+    detailed.spawn(Vector2u(1920, 1080), 49, Vector2i(960, 540), detailRandom);
+    const size_t fullSize = detailed.buildStream();
+    vector<Vertex> full(detailed.getStream(), detailed.getStream() + fullSize);
+    LodConfig coarse;
+    coarse.enabled = true;
+    coarse.pixelsPerEdge = 1000.0f;
+    detailed.setLod(coarse);
+    const size_t coarseSize = detailed.buildStream();
+    bool lodPassed = full.size() == 3 * 48 && coarseSize == 3 * 6
+        && detailed.drawnVertices() == 7 && detailed.lodSkippedVertices() == 42;
+    for (size_t t = 0; t < coarseSize / 3 && lodPassed; t++)
+    {
+        // Triangle t of the coarse fan spans full triangles 8t to 8t + 7
+        const Vertex* triangle = detailed.getStream() + 3 * t;
+        lodPassed = triangle[0].position == full[24 * t].position
+            && triangle[1].position == full[24 * t + 1].position
+            && triangle[2].position == full[24 * t + 23].position;
+    }
+    return lodPassed;
+}
+
+bool testSaveRestore()
+{
+    // A restored system carries on exactly as the saved one does, prebuilt
+    // shapes and recycled vertex blocks included; a cut-short state is refused
+    ParticleSystem saved;
+    Random saveRandom(7);
+    EmitterConfig pooled;
+    pooled.shapes = ShapeSource::Prebuilt;
+    pooled.prebuiltShapes = 16;
+    for (int i = 0; i < 40; i++)
+    {
+        saved.spawn(Vector2u(1920, 1080), i % 2 ? pooled : EmitterConfig(), Vector2i(960 + i, 540 - i), saveRandom);
+        saved.advance(0.1f);
+        saved.retireExpired();
+    }
+    vector<char> state;
+    ByteWriter stateOut(state);
+    saved.writeState(stateOut);
+    ParticleSystem restored;
+    ByteReader stateIn(state.data(), state.size());
+    bool restorePassed = restored.readState(stateIn) && stateIn.remaining() == 0 && restored.size() == saved.size()
+        && restored.checksum() == saved.checksum() && restored.vertexCount() == saved.vertexCount();
+    Random replayRandom = saveRandom;
+    for (int i = 0; i < 10 && restorePassed; i++)
+    {
+        saved.spawn(Vector2u(1920, 1080), pooled, Vector2i(100, 100), saveRandom);
+        restored.spawn(Vector2u(1920, 1080), pooled, Vector2i(100, 100), replayRandom);
+        saved.advance(0.05f);
+        saved.retireExpired();
+        restored.advance(0.05f);
+        restored.retireExpired();
+        restorePassed = restored.checksum() == saved.checksum() && restored.vertexCount() == saved.vertexCount();
+    }
+    ParticleSystem refused;
+    ByteReader cutShort(state.data(), state.size() / 2);
+    restorePassed = restorePassed && saved.size() > 0 && !refused.readState(cutShort) && refused.size() == 0;
+
+    // Two particles made to share one vertex block are refused too: retiring
+    // both would put the block on its free list twice
+    ParticleSystem pair;
+    Random pairRandom(7);
+    pair.spawn(Vector2u(1920, 1080), 30, Vector2i(960, 540), pairRandom);
+    pair.spawn(Vector2u(1920, 1080), 30, Vector2i(960, 540), pairRandom);
+    vector<char> pairState;
+    ByteWriter pairOut(pairState);
+    pair.writeState(pairOut);
+    // The offsets {0, 30} and the vertex counts {30, 30}, each after its length
+    vector<char> blocks;
+    ByteWriter blocksOut(blocks);
+    blocksOut.array(vector<int>{ 0, 30 });
+    blocksOut.array(vector<int>{ 30, 30 });
+    auto found = search(pairState.begin(), pairState.end(), blocks.begin(), blocks.end());
+    restorePassed = restorePassed && found != pairState.end();
+    if (found != pairState.end())
+    {
+        const int shared = 0;
+        memcpy(&*found + sizeof(uint64_t) + sizeof(int), &shared, sizeof(shared));
+        ByteReader overlapping(pairState.data(), pairState.size());
+        restorePassed = restorePassed && !refused.readState(overlapping) && refused.size() == 0;
+    }
+    return restorePassed;
+}
+
+bool testThreadCountDeterminism()
+{
+    // The same crowd, colliding and with spawns along the way, ends in the
+    // same state bit for bit whether updated on one thread or on three
+    CollisionConfig collisions;
+    collisions.enabled = true;
+    ThreadPool pool(3);
+    unsigned long long checksums[2] = { 0, 0 };
+    for (int run = 0; run < 2; run++)
+    {
+        ParticleSystem system;
+        system.setCollisions(collisions);
+        Random random(9);
+        for (int f = 0; f < 120; f++)
+        {
+            for (int i = 0; i < 10; i++)
+            {
+                system.spawn(Vector2u(1920, 1080), EmitterConfig(), Vector2i(900 + 10 * i, 500 + (f % 7) * 10), random);
+            }
+            system.update(1.0f / 60.0f, run == 0 ? nullptr : &pool);
+        }
+        checksums[run] = system.size() > 500 ? system.checksum() : 0;
+    }
+    return checksums[0] != 0 && checksums[0] == checksums[1];
+}
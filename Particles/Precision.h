@@ -0,0 +1,22 @@
+#pragma once
+#include "Matrices.h"
+
+// Build with PARTICLES_FLOAT32=1 (make FLOAT32=1) to store and transform
+// particle shapes in float instead of double: the vertex pool and the shape
+// library take half the memory, and a SIMD register holds twice as many
+// coordinates. Poses, the angle and scale accumulated since spawn, stay
+// double either way, and transforms are composed in double before being
+// rounded, so float only costs the rounding of each posed vertex.
+#ifndef PARTICLES_FLOAT32
+#define PARTICLES_FLOAT32 0
+#endif
+
+#if PARTICLES_FLOAT32
+typedef float ParticleScalar;
+#else
+typedef double ParticleScalar;
+#endif
+
+// Shapes of single particles, and the transforms that pose any shape
+typedef Matrices::BasicMatrix<ParticleScalar> ParticleMatrix;
+typedef Matrices::BasicAffineTransform<ParticleScalar> ParticleTransform;
@@ -0,0 +1,76 @@
+#include "Tests.h"
+#include "VertexKernels.h"
+#include <algorithm>
+
+bool testFloatPrecision()
+{
+    // Over a whole 3 second life at 60 Hz, float vertices must stay within a
+    // fraction of a pixel of double ones: both when every frame's transform
+    // is applied to the last frame's vertices, which compounds rounding, and
+    // when each frame poses the spawned shape afresh. Centers are tracked in
+    // double so only the vertex precision differs. Measured worst cases over
+    // these 20 particles: 0.014 px accumulated and 0.001 px posed.
+    Random driftRandom(17);
+    double accumulatedDrift = 0.0;
+    double posedDrift = 0.0;
+    for (int p = 0; p < 20; p++)
+    {
+        const int n = 50;
+        Matrix accumulated(2, n), local(2, n);
+        MatrixF accumulatedF(2, n), localF(2, n);
+        double cx = driftRandom.uniform(-960.0f, 960.0f);
+        double cy = driftRandom.uniform(-540.0f, 540.0f);
+        const double vx = driftRandom.uniform(100.0f, 500.0f) * (p % 2 ? 1 : -1);
+        double vy = driftRandom.uniform(100.0f, 500.0f);
+        const double spin = driftRandom.uniform(0.0f, static_cast<float>(M_PI));
+        for (int j = 0; j < n; j++)
+        {
+            const double r = driftRandom.uniform(20.0f, 80.0f);
+            const double angle = j * 2.0 * M_PI / (n - 1);
+            local(0, j) = r * cos(angle);
+            local(1, j) = r * sin(angle);
+            localF(0, j) = static_cast<float>(local(0, j));
+            localF(1, j) = static_cast<float>(local(1, j));
+            accumulated(0, j) = cx + local(0, j);
+            accumulated(1, j) = cy + local(1, j);
+            accumulatedF(0, j) = static_cast<float>(accumulated(0, j));
+            accumulatedF(1, j) = static_cast<float>(accumulated(1, j));
+        }
+        const double dt = 1.0 / 60.0;
+        double theta = 0.0;
+        double c = 1.0;
+        for (int f = 0; f < 180; f++)
+        {
+            const double dx = vx * dt;
+            vy -= G * dt;
+            const double dy = vy * dt;
+            VertexKernels::transform(AffineTransform::aboutCenter(dt * spin, SCALE, cx, cy, dx, dy),
+                accumulated.row(0), accumulated.row(1), n);
+            VertexKernels::transform(AffineTransformF::aboutCenter(dt * spin, SCALE, cx, cy, dx, dy),
+                accumulatedF.row(0), accumulatedF.row(1), n);
+            cx += dx;
+            cy += dy;
+            theta += dt * spin;
+            c *= SCALE;
+
+            Matrix posed = local;
+            MatrixF posedF = localF;
+            AffineTransform::pose(theta, c, cx, cy).apply(posed);
+            AffineTransformF::pose(theta, c, cx, cy).apply(posedF);
+            for (int i = 0; i < 2; i++)
+            {
+                for (int j = 0; j < n; j++)
+                {
+                    accumulatedDrift = max(accumulatedDrift, fabs(accumulatedF(i, j) - accumulated(i, j)));
+                    posedDrift = max(posedDrift, fabs(posedF(i, j) - posed(i, j)));
+                }
+            }
+        }
+    }
+    if (accumulatedDrift >= 0.1 || posedDrift >= 0.01)
+    {
+        cout << "Float drifted " << accumulatedDrift << " px accumulated, " << posedDrift << " px posed." << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,154 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+const size_t FrameProfiler::kFrames;
+
+FrameProfiler::FrameProfiler()
+    : m_ring(kFrames), m_completed(0)
+{
+    memset(&m_current, 0, sizeof(m_current));
+    m_scratch.reserve(kFrames);
+}
+
+const char* FrameProfiler::phaseName(int phase)
+{
+    static const char* const names[kPhaseCount + 1] = {
+        "input", "spawn", "transform", "expiry", "record", "build_vertices", "submit", "present", "frame"
+    };
+    return phase >= 0 && phase <= kPhaseCount ? names[phase] : "unknown";
+}
+
+void FrameProfiler::beginFrame()
+{
+    memset(&m_current, 0, sizeof(m_current));
+    m_frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame(size_t particles, size_t vertices, size_t drawnVertices, size_t lodSkipped)
+{
+    m_current.frameNs = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(Clock::now() - m_frameStart).count());
+    m_current.particles = static_cast<uint32_t>(particles);
+    m_current.vertices = static_cast<uint32_t>(vertices);
+    m_current.drawnVertices = static_cast<uint32_t>(drawnVertices);
+    m_current.lodSkipped = static_cast<uint32_t>(lodSkipped);
+
+    // Fill the slot, then publish it
+    const uint64_t frame = m_completed.load(memory_order_relaxed);
+    m_ring[frame & (kFrames - 1)] = m_current;
+    m_completed.store(frame + 1, memory_order_release);
+}
+
+FrameProfiler::Stats FrameProfiler::stats(int phase, size_t frames) const
+{
+    const uint64_t end = frameCount();
+    frames = static_cast<size_t>(min<uint64_t>(min(frames, kFrames), end));
+    Stats result = { 0.0, 0.0, 0.0 };
+    if (frames == 0)
+    {
+        return result;
+    }
+
+    m_scratch.clear();
+    for (uint64_t f = end - frames; f < end; f++)
+    {
+        const Sample& s = sample(f);
+        m_scratch.push_back((phase == kPhaseCount ? s.frameNs : s.ns[phase]) * 1e-6);
+    }
+    sort(m_scratch.begin(), m_scratch.end());
+
+    // Nearest rank
+    auto rank = [this](double p) {
+        size_t r = static_cast<size_t>(p / 100.0 * m_scratch.size() + 0.5);
+        return m_scratch[min(m_scratch.size() - 1, r > 0 ? r - 1 : 0)];
+    };
+    result.p50 = rank(50);
+    result.p99 = rank(99);
+    result.max = m_scratch.back();
+    return result;
+}
+
+size_t FrameProfiler::lastParticles() const
+{
+    const uint64_t end = frameCount();
+    return end > 0 ? sample(end - 1).particles : 0;
+}
+
+size_t FrameProfiler::lastVertices() const
+{
+    const uint64_t end = frameCount();
+    return end > 0 ? sample(end - 1).vertices : 0;
+}
+
+size_t FrameProfiler::lastDrawnVertices() const
+{
+    const uint64_t end = frameCount();
+    return end > 0 ? sample(end - 1).drawnVertices : 0;
+}
+
+size_t FrameProfiler::lastLodSkipped() const
+{
+    const uint64_t end = frameCount();
+    return end > 0 ? sample(end - 1).lodSkipped : 0;
+}
+
+void FrameProfiler::writeCsvHeader(ostream& out)
+{
+    out << "frame";
+    for (int p = 0; p <= kPhaseCount; p++)
+    {
+        out << "," << phaseName(p) << "_ms";
+    }
+    out << ",particles,vertices,drawn_vertices,lod_skipped\n";
+}
+
+void FrameProfiler::writeCsv(ostream& out, uint64_t from) const
+{
+    const uint64_t end = frameCount();
+    from = max(from, end > kFrames ? end - kFrames : 0);
+    out << fixed << setprecision(4);
+    for (uint64_t f = from; f < end; f++)
+    {
+        const Sample& s = sample(f);
+        out << f;
+        for (int p = 0; p < kPhaseCount; p++)
+        {
+            out << "," << s.ns[p] * 1e-6;
+        }
+        out << "," << s.frameNs * 1e-6 << "," << s.particles << "," << s.vertices
+            << "," << s.drawnVertices << "," << s.lodSkipped << "\n";
+    }
+}
+
+void FrameProfiler::writeJson(ostream& out, size_t frames) const
+{
+    frames = static_cast<size_t>(min<uint64_t>(min(frames, kFrames), frameCount()));
+    out << fixed << setprecision(4)
+        << "{\"frame\": " << frameCount() << ", \"frames\": " << frames
+        << ", \"particles\": " << lastParticles() << ", \"vertices\": " << lastVertices()
+        << ", \"drawn_vertices\": " << lastDrawnVertices() << ", \"lod_skipped\": " << lastLodSkipped();
+    for (int p = 0; p <= kPhaseCount; p++)
+    {
+        Stats s = stats(p, frames);
+        out << ", \"" << phaseName(p) << "\": {\"p50\": " << s.p50 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+    }
+    out << "}\n";
+}
+
+string FrameProfiler::summary(size_t frames) const
+{
+    ostringstream out;
+    out << fixed << setprecision(2)
+        << lastParticles() << " particles, " << lastVertices() << " vertices\n"
+        << lastDrawnVertices() << " drawn, " << lastLodSkipped() << " skipped by LOD\n"
+        << left << setw(16) << "ms" << right << setw(8) << "p50" << setw(8) << "p99" << setw(8) << "max" << "\n";
+    for (int p = 0; p <= kPhaseCount; p++)
+    {
+        Stats s = stats(p, frames);
+        out << left << setw(16) << phaseName(p) << right << setw(8) << s.p50 << setw(8) << s.p99 << setw(8) << s.max << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Build with PARTICLES_PROFILING=0 (make PROFILING=0) to compile every
+// PROFILE_ macro out; the profiler then costs nothing at all.
+#ifndef PARTICLES_PROFILING
+#define PARTICLES_PROFILING 1
+#endif
+
+// Per-phase frame timings. Scoped timers add the time spent in each phase of
+// the current frame; endFrame files the frame into a ring buffer holding the
+// last kFrames frames, from which percentiles and exports are computed.
+// One thread records. It publishes each finished frame with an atomic
+// counter, so readers never lock; a reader that falls kFrames frames behind
+// may see newer samples than it asked for.
+class FrameProfiler
+{
+public:
+    enum Phase
+    {
+        Input,         // Event handling, spawning included
+        Spawn,         // Creating particles
+        Transform,     // Advancing the particles
+        Expiry,        // Retiring expired particles
+        Record,        // Recording the frame for replay
+        BuildVertices, // Filling the draw stream
+        Submit,        // Handing the stream to the GPU
+        Present,       // Displaying the frame
+        kPhaseCount
+    };
+
+    static const size_t kFrames = 1024; // Frames of history, a power of two
+
+    // Milliseconds
+    struct Stats
+    {
+        double p50;
+        double p99;
+        double max;
+    };
+
+    typedef chrono::steady_clock Clock;
+
+    FrameProfiler();
+
+    static const char* phaseName(int phase); // kPhaseCount is the whole frame
+
+    void beginFrame();
+    void add(Phase phase, uint64_t ns) { m_current.ns[phase] += ns; }
+    // Counts of the frame: live particles and vertices, the vertices drawn,
+    // and the ones level of detail skipped
+    void endFrame(size_t particles, size_t vertices, size_t drawnVertices = 0, size_t lodSkipped = 0);
+
+    // Frames recorded so far
+    uint64_t frameCount() const { return m_completed.load(memory_order_acquire); }
+
+    // Statistics of a phase over the last frames recorded (at most kFrames).
+    // Phase kPhaseCount gives the whole frame.
+    Stats stats(int phase, size_t frames = kFrames) const;
+
+    // Counts of the last frame, as passed to endFrame
+    size_t lastParticles() const;
+    size_t lastVertices() const;
+    size_t lastDrawnVertices() const;
+    size_t lastLodSkipped() const;
+
+    // One CSV row per frame for frames [from, frameCount()) still in the history
+    static void writeCsvHeader(ostream& out);
+    void writeCsv(ostream& out, uint64_t from) const;
+
+    // One JSON object on a line: p50/p99/max per phase over the last frames
+    void writeJson(ostream& out, size_t frames) const;
+
+    // A few lines of text with the same numbers, for the overlay
+    string summary(size_t frames = kFrames) const;
+
+private:
+    struct Sample
+    {
+        uint64_t ns[kPhaseCount];
+        uint64_t frameNs;
+        uint32_t particles;
+        uint32_t vertices;
+        uint32_t drawnVertices;
+        uint32_t lodSkipped;
+    };
+
+    vector<Sample> m_ring;
+    Sample m_current;
+    Clock::time_point m_frameStart;
+    atomic<uint64_t> m_completed;
+    mutable vector<double> m_scratch; // Sorted copies for percentiles, allocated once
+
+    const Sample& sample(uint64_t frame) const { return m_ring[frame & (kFrames - 1)]; }
+};
+
+// Adds the time from construction to destruction to a phase of the current
+// frame. A null profiler records nothing.
+class ScopedPhase
+{
+public:
+    ScopedPhase(FrameProfiler* profiler, FrameProfiler::Phase phase)
+        : m_profiler(profiler), m_phase(phase)
+    {
+        if (m_profiler)
+        {
+            m_start = FrameProfiler::Clock::now();
+        }
+    }
+
+    ~ScopedPhase()
+    {
+        if (m_profiler)
+        {
+            m_profiler->add(m_phase, static_cast<uint64_t>(
+                chrono::duration_cast<chrono::nanoseconds>(FrameProfiler::Clock::now() - m_start).count()));
+        }
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    FrameProfiler* m_profiler;
+    FrameProfiler::Phase m_phase;
+    FrameProfiler::Clock::time_point m_start;
+};
+
+#if PARTICLES_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Time the rest of the enclosing block as a phase, e.g. PROFILE_SCOPE(profiler, Expiry)
+#define PROFILE_SCOPE(profiler, phase) ScopedPhase PROFILE_CONCAT(profileScope, __LINE__)((profiler), FrameProfiler::phase)
+#define PROFILE_BEGIN_FRAME(profiler) do { if (profiler) (profiler)->beginFrame(); } while (0)
+#define PROFILE_END_FRAME(profiler, ...) do { if (profiler) (profiler)->endFrame(__VA_ARGS__); } while (0)
+#else
+#define PROFILE_SCOPE(profiler, phase) do { } while (0)
+#define PROFILE_BEGIN_FRAME(profiler) do { } while (0)
+#define PROFILE_END_FRAME(profiler, ...) do { } while (0)
+#endif
@@ -0,0 +1,55 @@
+#include "ProfilerOverlay.h"
+
+ProfilerOverlay::ProfilerOverlay()
+    : m_hasFont(false)
+{
+}
+
+bool ProfilerOverlay::loadFont(const string& path)
+{
+    // Monospaced fonts first, so the columns line up
+    static const char* const systemFonts[] = {
+        "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+        "/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+        "/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
+        "/Library/Fonts/Courier New.ttf",
+        "C:/Windows/Fonts/consola.ttf",
+        "C:/Windows/Fonts/cour.ttf",
+    };
+
+    m_hasFont = false;
+    if (!path.empty())
+    {
+        m_hasFont = m_font.loadFromFile(path);
+    }
+    for (size_t i = 0; !m_hasFont && path.empty() && i < sizeof(systemFonts) / sizeof(systemFonts[0]); i++)
+    {
+        m_hasFont = m_font.loadFromFile(systemFonts[i]);
+    }
+
+    if (m_hasFont)
+    {
+        m_text.setFont(m_font);
+        m_text.setCharacterSize(14);
+        m_text.setFillColor(Color::Yellow);
+        m_text.setPosition(8.f, 8.f);
+    }
+    return m_hasFont;
+}
+
+void ProfilerOverlay::refresh(const FrameProfiler& profiler, const string& extra)
+{
+    if (m_hasFont)
+    {
+        m_text.setString(profiler.summary(120) + extra);
+    }
+}
+
+void ProfilerOverlay::draw(RenderTarget& target, RenderStates states) const
+{
+    // The engine's view is one unit per pixel, so this is the top-left corner
+    if (m_hasFont)
+    {
+        target.draw(m_text, states);
+    }
+}
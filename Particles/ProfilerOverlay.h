@@ -0,0 +1,29 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "Profiler.h"
+using namespace sf;
+
+// On-screen text with a FrameProfiler's numbers: p50/p99/max per phase and
+// the live particle and vertex counts. Needs a font file; without one the
+// engine shows a one-line summary in the window title instead.
+class ProfilerOverlay : public Drawable
+{
+public:
+    ProfilerOverlay();
+
+    // Load the font from path, or from the usual system locations if empty
+    bool loadFont(const string& path = string());
+    bool hasFont() const { return m_hasFont; }
+
+    // Rebuild the text from the profiler, with extra lines below if given.
+    // Sorting the history is not free, so call it every few frames rather
+    // than every frame.
+    void refresh(const FrameProfiler& profiler, const string& extra = string());
+
+    virtual void draw(RenderTarget& target, RenderStates states) const override;
+
+private:
+    Font m_font;
+    Text m_text;
+    bool m_hasFont;
+};
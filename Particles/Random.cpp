@@ -0,0 +1,35 @@
+#include "Random.h"
+#include <atomic>
+
+const uint64_t Random::kDefaultSeed;
+
+Random::Random(uint64_t seed, uint64_t stream)
+{
+    this->seed(seed, stream);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream)
+{
+    // Standard PCG32 seeding sequence
+    m_state = 0;
+    m_increment = (stream << 1u) | 1u;
+    next();
+    m_state += seed;
+    next();
+}
+
+void Random::fillUniform(float* out, size_t n, float lo, float hi)
+{
+    const float scale = (hi - lo) * (1.0f / 16777216.0f);
+    for (size_t k = 0; k < n; k++)
+    {
+        out[k] = lo + static_cast<float>(next() >> 8) * scale;
+    }
+}
+
+Random& Random::threadLocal()
+{
+    static std::atomic<uint64_t> nextStream(1);
+    thread_local Random random(kDefaultSeed, nextStream.fetch_add(1));
+    return random;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Small, fast, seedable random number generator (PCG32, XSH-RR variant).
+// 16 bytes of state, no locks and no global state: give each thread or each
+// emitter its own Random. Generators built from the same seed but different
+// stream numbers produce independent sequences, so one run seed is enough to
+// make a whole multi-threaded run reproducible.
+class Random
+{
+public:
+    explicit Random(uint64_t seed = kDefaultSeed, uint64_t stream = 0);
+
+    // Restart the sequence for (seed, stream)
+    void seed(uint64_t seed, uint64_t stream = 0);
+
+    // 32 uniformly distributed bits
+    uint32_t next()
+    {
+        uint64_t old = m_state;
+        m_state = old * 6364136223846793005ULL + m_increment;
+        uint32_t xorShifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = static_cast<uint32_t>(old >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+    }
+
+    // Uniform float in [0, 1)
+    float uniform()
+    {
+        return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Uniform float in [lo, hi)
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * uniform();
+    }
+
+    // Uniform int in [lo, hi], both ends included
+    int uniformInt(int lo, int hi)
+    {
+        // Multiply-shift maps 32 bits onto the range without a division
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(hi) - lo + 1);
+        return lo + static_cast<int>((static_cast<uint64_t>(next()) * range) >> 32);
+    }
+
+    // true or false with equal odds
+    bool coinFlip()
+    {
+        return (next() >> 31) != 0;
+    }
+
+    // Batch versions: fill out[0 .. n - 1] in one call
+    void fillUniform(float* out, size_t n, float lo, float hi);
+
+    template <typename T>
+    void fillInt(T* out, size_t n, int lo, int hi)
+    {
+        for (size_t k = 0; k < n; k++)
+        {
+            out[k] = static_cast<T>(uniformInt(lo, hi));
+        }
+    }
+
+    // The whole generator state, to save and restore a sequence mid-way
+    struct State
+    {
+        uint64_t state;
+        uint64_t increment;
+    };
+    State getState() const { return State{ m_state, m_increment }; }
+    void setState(const State& state) { m_state = state.state; m_increment = state.increment; }
+
+    // This thread's own generator, for callers that do not manage one.
+    // Every thread gets a different stream of kDefaultSeed.
+    static Random& threadLocal();
+
+    static const uint64_t kDefaultSeed = 0x853c49e6748fea9bULL;
+
+private:
+    uint64_t m_state;
+    uint64_t m_increment; // Selects the stream, always odd
+};
@@ -0,0 +1,20 @@
+#include "Tests.h"
+#include "Random.h"
+
+bool testRandomStreams()
+{
+    Random first(42, 7), second(42, 7), otherStream(42, 8);
+    bool randomPassed = true;
+    bool streamsDiffer = false;
+    for (int k = 0; k < 1000; k++)
+    {
+        uint32_t a = first.next();
+        randomPassed = randomPassed && a == second.next();
+        streamsDiffer = streamsDiffer || a != otherStream.next();
+        int n = second.uniformInt(20, 80);
+        float u = second.uniform();
+        randomPassed = randomPassed && first.uniformInt(20, 80) == n && first.uniform() == u;
+        randomPassed = randomPassed && n >= 20 && n <= 80 && u >= 0.0f && u < 1.0f;
+    }
+    return randomPassed && streamsDiffer;
+}
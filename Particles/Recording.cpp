@@ -0,0 +1,443 @@
+#include "Recording.h"
+#include "InputSource.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char kMagic[8] = { 'P', 'R', 'T', 'C', 'L', 'R', 'E', 'C' };
+
+    // Record type and payload size
+    const size_t kRecordHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+    // A spawn a replay can make: the limits of a SpawnCommand, and a vertex
+    // range that is either valid or 0s for the emitter's
+    bool validSpawn(const SpawnEvent& spawn)
+    {
+        const bool emitterRange = spawn.minPoints == 0 && spawn.maxPoints == 0;
+        return spawn.count >= 0 && spawn.count <= SpawnCommand::kMaxCount
+            && (emitterRange || (spawn.minPoints >= 2 && spawn.maxPoints >= spawn.minPoints
+                                 && spawn.maxPoints <= SpawnCommand::kMaxPoints));
+    }
+
+    // Bytes per stored vertex coordinate, 4 in a FLOAT32 build
+    const uint8_t kScalarBytes = sizeof(ParticleScalar);
+}
+
+const uint32_t RecordingHeader::kVersion;
+const uint32_t RecordingHeader::kByteOrderMark;
+const size_t RecordingWriter::kHandoffBytes;
+const unsigned RecordingWriter::kHandoffFrames;
+
+void RecordingHeader::write(ByteWriter& out) const
+{
+    // Field by field, so the layout does not depend on struct padding
+    out.bytes(kMagic, sizeof(kMagic));
+    out.pod(kVersion);
+    out.pod(kByteOrderMark);
+    out.pod(kScalarBytes);
+    out.pod(width);
+    out.pod(height);
+    out.pod(seed);
+    out.pod(timestep);
+    out.pod(tickSeconds);
+    out.pod(static_cast<uint8_t>(emitter.shapes));
+    out.pod(static_cast<int32_t>(emitter.minPoints));
+    out.pod(static_cast<int32_t>(emitter.maxPoints));
+    out.pod(static_cast<uint64_t>(emitter.prebuiltShapes));
+    out.pod(static_cast<uint8_t>(collisions.enabled));
+    out.pod(collisions.restitution);
+    out.pod(collisions.separation);
+    out.pod(static_cast<uint8_t>(retireOffscreen));
+    out.pod(checksumEvery);
+    out.pod(snapshotEvery);
+}
+
+bool RecordingHeader::read(ByteReader& in, string& error)
+{
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    uint32_t byteOrder = 0;
+    uint8_t scalarBytes = 0;
+    if (!in.bytes(magic, sizeof(magic)) || !equal(magic, magic + sizeof(magic), kMagic))
+    {
+        error = "not a particle recording";
+        return false;
+    }
+    if (!in.pod(version) || !in.pod(byteOrder))
+    {
+        error = "header cut short";
+        return false;
+    }
+    if (byteOrder != kByteOrderMark)
+    {
+        error = "recorded on a machine of the other byte order";
+        return false;
+    }
+    if (version != kVersion)
+    {
+        error = "recording version " + to_string(version) + ", expected " + to_string(kVersion);
+        return false;
+    }
+    if (!in.pod(scalarBytes))
+    {
+        error = "header cut short";
+        return false;
+    }
+    if (scalarBytes != kScalarBytes)
+    {
+        error = "recorded with " + to_string(scalarBytes * 8) + "-bit vertices, this build stores "
+                + to_string(kScalarBytes * 8) + "-bit ones";
+        return false;
+    }
+
+    uint8_t shapes = 0, collide = 0, retire = 0;
+    int32_t minPoints = 0, maxPoints = 0;
+    uint64_t prebuilt = 0;
+    if (!(in.pod(width) && in.pod(height) && in.pod(seed) && in.pod(timestep) && in.pod(tickSeconds) && in.pod(shapes)
+          && in.pod(minPoints) && in.pod(maxPoints) && in.pod(prebuilt) && in.pod(collide) && in.pod(collisions.restitution)
+          && in.pod(collisions.separation) && in.pod(retire) && in.pod(checksumEvery) && in.pod(snapshotEvery)))
+    {
+        error = "header cut short";
+        return false;
+    }
+    // Threaded sessions are not recorded: their ticks do not follow frames
+    const bool prebuiltShapes = shapes == static_cast<uint8_t>(ShapeSource::Prebuilt);
+    if (timestep > 1 || shapes > static_cast<uint8_t>(ShapeSource::Prebuilt) || minPoints < 2 || maxPoints < minPoints
+        || maxPoints > SpawnCommand::kMaxPoints || (prebuiltShapes && (prebuilt == 0 || prebuilt > EmitterConfig::kMaxPrebuiltShapes))
+        || width == 0 || height == 0 || !(tickSeconds > 0.0))
+    {
+        error = "header settings out of range";
+        return false;
+    }
+    emitter.shapes = static_cast<ShapeSource>(shapes);
+    emitter.minPoints = minPoints;
+    emitter.maxPoints = maxPoints;
+    emitter.prebuiltShapes = static_cast<size_t>(prebuilt);
+    collisions.enabled = collide != 0;
+    retireOffscreen = retire != 0;
+    return true;
+}
+
+RecordingWriter::RecordingWriter()
+    : m_file(nullptr), m_recordStart(0), m_framesBuffered(0), m_stopping(false), m_failed(false)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+}
+
+bool RecordingWriter::open(const string& path, const RecordingHeader& header)
+{
+    close();
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        return false;
+    }
+    m_header = header;
+    m_stats = Stats();
+    m_stopping = false;
+    m_failed = false;
+    m_spawns.clear();
+    m_buffer.clear();
+    m_framesBuffered = 0;
+
+    ByteWriter out(m_buffer);
+    header.write(out);
+    m_stats.bytes = m_buffer.size();
+    m_thread = thread(&RecordingWriter::loop, this);
+    return true;
+}
+
+void RecordingWriter::close()
+{
+    if (!m_file)
+    {
+        return;
+    }
+    handoff();
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_stats.failed = m_failed;
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void RecordingWriter::spawn(Vector2i position, int count, int minPoints, int maxPoints)
+{
+    // A range the emitter would ignore is recorded as the emitter's own
+    if (minPoints < 2 || maxPoints < minPoints || maxPoints > SpawnCommand::kMaxPoints)
+    {
+        minPoints = 0;
+        maxPoints = 0;
+    }
+    // Spawns are made one particle after the other, so a large one replays
+    // the same as several of at most kMaxCount
+    do
+    {
+        const int part = min(count, SpawnCommand::kMaxCount);
+        m_spawns.push_back(SpawnEvent{ position.x, position.y, part, minPoints, maxPoints });
+        count -= part;
+    } while (count > 0);
+}
+
+uint64_t RecordingWriter::endFrame(float dt)
+{
+    ByteWriter out = beginRecord(RecordType::Frame);
+    out.pod(dt);
+    out.pod(static_cast<uint32_t>(m_spawns.size()));
+    if (!m_spawns.empty())
+    {
+        out.bytes(m_spawns.data(), m_spawns.size() * sizeof(SpawnEvent));
+    }
+    m_spawns.clear();
+    endRecord();
+
+    m_stats.frames++;
+    m_framesBuffered++;
+    if (m_buffer.size() >= kHandoffBytes || m_framesBuffered >= kHandoffFrames)
+    {
+        handoff();
+    }
+    return m_stats.frames;
+}
+
+void RecordingWriter::checksum(uint64_t frame, uint64_t checksum, uint64_t particles)
+{
+    ByteWriter out = beginRecord(RecordType::Checksum);
+    out.pod(frame);
+    out.pod(checksum);
+    out.pod(particles);
+    endRecord();
+    m_stats.checksums++;
+}
+
+ByteWriter RecordingWriter::beginSnapshot(uint64_t frame, uint64_t checksum)
+{
+    ByteWriter out = beginRecord(RecordType::Snapshot);
+    out.pod(frame);
+    out.pod(checksum);
+    m_stats.snapshots++;
+    return out;
+}
+
+ByteWriter RecordingWriter::beginRecord(RecordType type)
+{
+    // The size is filled in by endRecord
+    m_recordStart = m_buffer.size();
+    ByteWriter out(m_buffer);
+    out.pod(static_cast<uint8_t>(type));
+    out.pod(static_cast<uint32_t>(0));
+    return out;
+}
+
+void RecordingWriter::endRecord()
+{
+    const uint32_t size = static_cast<uint32_t>(m_buffer.size() - m_recordStart - kRecordHeaderSize);
+    memcpy(&m_buffer[m_recordStart + sizeof(uint8_t)], &size, sizeof(size));
+    m_stats.bytes += m_buffer.size() - m_recordStart;
+}
+
+RecordingWriter::Stats RecordingWriter::stats() const
+{
+    Stats stats = m_stats;
+    lock_guard<mutex> lock(m_mutex);
+    stats.failed = m_failed;
+    return stats;
+}
+
+void RecordingWriter::handoff()
+{
+    m_framesBuffered = 0;
+    if (m_buffer.empty())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_queue.push_back(vector<char>());
+        m_queue.back().swap(m_buffer);
+        m_stats.maxQueued = max(m_stats.maxQueued, m_queue.size());
+        if (!m_spare.empty())
+        {
+            m_buffer.swap(m_spare.back());
+            m_spare.pop_back();
+        }
+    }
+    m_wake.notify_one();
+    m_stats.handoffs++;
+}
+
+void RecordingWriter::loop()
+{
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty())
+        {
+            break;
+        }
+        vector<char> buffer;
+        buffer.swap(m_queue.front());
+        m_queue.pop_front();
+
+        // The disk is only touched with the lock released
+        lock.unlock();
+        const bool written = m_failed || fwrite(buffer.data(), 1, buffer.size(), m_file) == buffer.size();
+        buffer.clear();
+        lock.lock();
+
+        m_failed = m_failed || !written;
+        m_spare.push_back(vector<char>());
+        m_spare.back().swap(buffer);
+    }
+    if (fflush(m_file) != 0)
+    {
+        m_failed = true;
+    }
+}
+
+RecordingReader::RecordingReader() : m_data(nullptr), m_size(0), m_truncated(false)
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+    close();
+}
+
+bool RecordingReader::open(const string& path, string& error)
+{
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        error = "cannot read " + path;
+        return false;
+    }
+
+    // The mapping stays valid once the descriptor is closed
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        error = "cannot map " + path;
+        return false;
+    }
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    ByteReader in(m_data, m_size);
+    if (!m_header.read(in, error))
+    {
+        close();
+        return false;
+    }
+
+    // Index the records; unknown types are skipped
+    while (in.remaining() > 0)
+    {
+        uint8_t type = 0;
+        uint32_t size = 0;
+        const char* payload = nullptr;
+        if (!in.pod(type) || !in.pod(size) || !(payload = in.skip(size)))
+        {
+            m_truncated = true;
+            break;
+        }
+        ByteReader record(payload, size);
+        if (type == static_cast<uint8_t>(RecordType::Frame))
+        {
+            float dt = 0.0f;
+            uint32_t spawns = 0;
+            bool valid = record.pod(dt) && record.pod(spawns) && record.remaining() / sizeof(SpawnEvent) >= spawns;
+            for (uint32_t k = 0; k < spawns && valid; k++)
+            {
+                SpawnEvent spawn;
+                valid = record.pod(spawn) && validSpawn(spawn);
+            }
+            if (!valid)
+            {
+                error = "damaged frame record";
+                close();
+                return false;
+            }
+            m_frames.push_back(payload);
+        }
+        else if (type == static_cast<uint8_t>(RecordType::Checksum))
+        {
+            ChecksumRecord checksum;
+            if (!record.pod(checksum.frame) || !record.pod(checksum.checksum) || !record.pod(checksum.particles))
+            {
+                error = "damaged checksum record";
+                close();
+                return false;
+            }
+            m_checksums.push_back(checksum);
+        }
+        else if (type == static_cast<uint8_t>(RecordType::Snapshot))
+        {
+            SnapshotRecord snapshot;
+            if (!record.pod(snapshot.frame) || !record.pod(snapshot.checksum))
+            {
+                error = "damaged snapshot record";
+                close();
+                return false;
+            }
+            snapshot.state = record.position();
+            snapshot.size = record.remaining();
+            m_snapshots.push_back(snapshot);
+        }
+    }
+    if (m_snapshots.empty() || m_snapshots.front().frame != 0)
+    {
+        error = "no snapshot of frame 0";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void RecordingReader::close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_frames.clear();
+    m_checksums.clear();
+    m_snapshots.clear();
+    m_truncated = false;
+}
+
+RecordingReader::Frame RecordingReader::frame(uint64_t n) const
+{
+    // Checked when the file was indexed
+    const char* payload = m_frames[static_cast<size_t>(n - 1)];
+    float dt;
+    uint32_t spawns;
+    memcpy(&dt, payload, sizeof(dt));
+    memcpy(&spawns, payload + sizeof(dt), sizeof(spawns));
+    return Frame(payload + sizeof(dt) + sizeof(spawns), spawns, dt);
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "ByteStream.h"
+#include "ParticleSystem.h"
+#include "ShapeLibrary.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace sf;
+using namespace std;
+
+// Binary recordings of engine sessions, for replaying them offline.
+//
+// A recording is a header, then a sequence of records, each a type byte, a
+// 32-bit payload size and the payload. Frame records hold a frame's spawns and
+// its duration: with the settings in the header, that is all it takes to run
+// the frame again exactly. Checksum records hold the state's checksum after
+// a frame, and snapshot records the whole engine state, so that a replay can
+// both check itself and start anywhere near a snapshot. The first record is
+// always a snapshot of frame 0, the state when recording started.
+//
+// Values are stored in the byte order of the machine that recorded them; the
+// header says which, and a reader on a machine of the other order refuses
+// the file. So does a reader built with the other vertex precision, since
+// snapshots hold the vertices as they are stored. A file cut short, e.g. by a crash, reads up to its last whole record.
+
+enum class RecordType : uint8_t
+{
+    Frame = 1,    // float dt, uint32 spawn count, then that many SpawnEvents
+    Checksum = 2, // uint64 frame, uint64 checksum, uint64 particles
+    Snapshot = 3  // uint64 frame, uint64 checksum, then Engine::writeState
+};
+
+// One spawn call: count particles at a pixel position, with vertex counts in
+// [minPoints, maxPoints], or the emitter's range when both are 0. Within the
+// limits of a SpawnCommand: larger spawns are recorded as several events.
+struct SpawnEvent
+{
+    int32_t x;
+    int32_t y;
+    int32_t count;
+    int32_t minPoints;
+    int32_t maxPoints;
+};
+
+// Everything besides the recorded frames that decides how a session runs
+struct RecordingHeader
+{
+    static const uint32_t kVersion = 4;
+    static const uint32_t kByteOrderMark = 0x01020304;
+
+    uint32_t width = 0;               // Simulated screen, in pixels
+    uint32_t height = 0;
+    uint64_t seed = 0;                // Run seed; snapshots hold the generator itself
+    uint8_t timestep = 0;             // Timestep, as a number
+    double tickSeconds = 0.0;
+    EmitterConfig emitter;
+    CollisionConfig collisions;
+    bool retireOffscreen = false;
+    uint32_t checksumEvery = 0;       // Frames between checksum records, 0 for none
+    uint32_t snapshotEvery = 0;       // Frames between snapshots, 0 for frame 0 only
+
+    void write(ByteWriter& out) const;
+
+    // False, with the reason in error, if in does not start with a header
+    // this version can read
+    bool read(ByteReader& in, string& error);
+};
+
+// Writes a recording from the game thread without ever waiting for the disk.
+// Records go into a memory buffer; every 64 KB or 60 frames the buffer is
+// handed to a background thread that writes it out, and the game thread goes
+// on with a spare buffer. Buffers come back once written, so a steady
+// recording stops allocating after its first few hand-offs.
+class RecordingWriter
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t checksums = 0;
+        uint64_t snapshots = 0;
+        uint64_t bytes = 0;           // Recorded, whether written yet or not
+        uint64_t handoffs = 0;        // Buffers passed to the writer thread
+        size_t maxQueued = 0;         // Most buffers ever waiting to be written
+        bool failed = false;          // A write failed; later data is lost
+    };
+
+    RecordingWriter();
+    ~RecordingWriter();
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    // Create path, write the header and start the writer thread
+    bool open(const string& path, const RecordingHeader& header);
+
+    // Write out everything recorded so far, stop the thread and close the file
+    void close();
+
+    bool isOpen() const { return m_file != nullptr; }
+    const RecordingHeader& header() const { return m_header; }
+
+    // A spawn in the frame being recorded
+    void spawn(Vector2i position, int count, int minPoints, int maxPoints);
+
+    // End the frame being recorded, which lasted dt; returns its number, from 1
+    uint64_t endFrame(float dt);
+
+    void checksum(uint64_t frame, uint64_t checksum, uint64_t particles);
+
+    // Start a snapshot record; the caller writes the engine state to the
+    // writer returned, then calls endRecord
+    ByteWriter beginSnapshot(uint64_t frame, uint64_t checksum);
+    void endRecord();
+
+    uint64_t frames() const { return m_stats.frames; }
+
+    // Safe to call while recording: the counters are the game thread's own
+    Stats stats() const;
+
+private:
+    static const size_t kHandoffBytes = 64 * 1024;
+    static const unsigned kHandoffFrames = 60;
+
+    RecordingHeader m_header;
+    FILE* m_file;
+
+    // Game thread only
+    vector<char> m_buffer;            // Records not handed off yet
+    vector<SpawnEvent> m_spawns;      // Spawns of the frame being recorded
+    size_t m_recordStart;             // Offset in m_buffer of the open record
+    unsigned m_framesBuffered;
+    Stats m_stats;
+
+    // Shared with the writer thread
+    mutable mutex m_mutex;
+    condition_variable m_wake;
+    deque<vector<char>> m_queue;      // Buffers waiting to be written
+    vector<vector<char>> m_spare;     // Written buffers, ready for reuse
+    bool m_stopping;
+    bool m_failed;
+    thread m_thread;
+
+    ByteWriter beginRecord(RecordType type);
+    void handoff();
+    void loop();
+};
+
+// Read-only view of a recording, mapped into memory. Opening it indexes the
+// records; frames and snapshots are then decoded straight from the mapping.
+class RecordingReader
+{
+public:
+    struct ChecksumRecord
+    {
+        uint64_t frame;
+        uint64_t checksum;
+        uint64_t particles;
+    };
+
+    struct SnapshotRecord
+    {
+        uint64_t frame;
+        uint64_t checksum;
+        const char* state;            // Engine::writeState data, in the mapping
+        size_t size;
+    };
+
+    // A frame record, decoded on demand
+    class Frame
+    {
+    public:
+        Frame(const char* spawns, uint32_t count, float dt) : m_spawns(spawns), m_count(count), m_dt(dt) {}
+
+        float dt() const { return m_dt; }
+        uint32_t spawnCount() const { return m_count; }
+        SpawnEvent spawn(uint32_t k) const
+        {
+            // Records are not aligned in the file
+            SpawnEvent event;
+            memcpy(&event, m_spawns + k * sizeof(SpawnEvent), sizeof(SpawnEvent));
+            return event;
+        }
+
+    private:
+        const char* m_spawns;
+        uint32_t m_count;
+        float m_dt;
+    };
+
+    RecordingReader();
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    // Map and index path; false, with the reason in error, if it is not a recording
+    bool open(const string& path, string& error);
+    void close();
+
+    const RecordingHeader& header() const { return m_header; }
+
+    // Frames are numbered from 1; frame n is the n-th frame record
+    uint64_t frameCount() const { return m_frames.size(); }
+    Frame frame(uint64_t n) const;
+
+    // In frame order
+    const vector<ChecksumRecord>& checksums() const { return m_checksums; }
+    const vector<SnapshotRecord>& snapshots() const { return m_snapshots; }
+
+    size_t fileSize() const { return m_size; }
+    bool truncated() const { return m_truncated; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    RecordingHeader m_header;
+    vector<const char*> m_frames;     // Payload of each frame record
+    vector<ChecksumRecord> m_checksums;
+    vector<SnapshotRecord> m_snapshots;
+    bool m_truncated;                 // The file ends inside a record
+};
@@ -0,0 +1,123 @@
+#include "Replay.h"
+#include <algorithm>
+#include <chrono>
+
+Replay::Replay(const RecordingReader& recording) : m_recording(recording), m_frame(0)
+{
+}
+
+bool Replay::start(Engine& engine)
+{
+    const RecordingHeader& header = m_recording.header();
+    if (engine.getSize() != Vector2u(header.width, header.height))
+    {
+        return false;
+    }
+    engine.stopRecording();
+    engine.setTimestep(static_cast<Timestep>(header.timestep), 1.0 / header.tickSeconds);
+    engine.setEmitter(header.emitter);
+    engine.setCollisions(header.collisions);
+    engine.setRetireOffscreen(header.retireOffscreen);
+    return restore(engine, m_recording.snapshots().front());
+}
+
+bool Replay::seek(Engine& engine, uint64_t frame)
+{
+    if (frame > m_recording.frameCount())
+    {
+        return false;
+    }
+    // Playing on from where the engine is beats restoring an earlier snapshot
+    const vector<RecordingReader::SnapshotRecord>& snapshots = m_recording.snapshots();
+    auto after = upper_bound(snapshots.begin(), snapshots.end(), frame,
+                             [](uint64_t f, const RecordingReader::SnapshotRecord& s) { return f < s.frame; });
+    const RecordingReader::SnapshotRecord& nearest = *(after - 1);
+    if ((frame < m_frame || nearest.frame > m_frame) && !restore(engine, nearest))
+    {
+        return false;
+    }
+    while (m_frame < frame)
+    {
+        playFrame(engine);
+    }
+    return true;
+}
+
+Replay::Report Replay::play(Engine& engine, uint64_t frames, bool verify, const function<void(float)>& afterFrame)
+{
+    Report report;
+    const vector<RecordingReader::ChecksumRecord>& checksums = m_recording.checksums();
+    const vector<RecordingReader::SnapshotRecord>& snapshots = m_recording.snapshots();
+
+    // Both lists are in frame order: skip to the first record after this frame
+    auto checksum = upper_bound(checksums.begin(), checksums.end(), m_frame,
+                                [](uint64_t f, const RecordingReader::ChecksumRecord& c) { return f < c.frame; });
+    auto snapshot = upper_bound(snapshots.begin(), snapshots.end(), m_frame,
+                                [](uint64_t f, const RecordingReader::SnapshotRecord& s) { return f < s.frame; });
+
+    const uint64_t end = min(m_recording.frameCount(), m_frame + frames);
+    const auto start = chrono::steady_clock::now();
+    while (m_frame < end)
+    {
+        const float alpha = playFrame(engine);
+        report.frames++;
+        if (afterFrame)
+        {
+            afterFrame(alpha);
+        }
+        if (!verify)
+        {
+            continue;
+        }
+
+        // Check every record of this frame
+        unsigned long long recorded[2];
+        int count = 0;
+        if (checksum != checksums.end() && checksum->frame == m_frame)
+        {
+            recorded[count++] = (checksum++)->checksum;
+        }
+        if (snapshot != snapshots.end() && snapshot->frame == m_frame)
+        {
+            recorded[count++] = (snapshot++)->checksum;
+        }
+        if (count > 0)
+        {
+            const unsigned long long actual = engine.getChecksum();
+            for (int k = 0; k < count; k++)
+            {
+                report.checks++;
+                if (recorded[k] != actual)
+                {
+                    report.mismatches++;
+                    report.firstMismatch = report.firstMismatch ? report.firstMismatch : m_frame;
+                }
+            }
+        }
+    }
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+float Replay::playFrame(Engine& engine)
+{
+    m_frame++;
+    const RecordingReader::Frame frame = m_recording.frame(m_frame);
+    for (uint32_t k = 0; k < frame.spawnCount(); k++)
+    {
+        const SpawnEvent spawn = frame.spawn(k);
+        engine.spawn(Vector2i(spawn.x, spawn.y), spawn.count, spawn.minPoints, spawn.maxPoints);
+    }
+    return engine.advance(frame.dt());
+}
+
+bool Replay::restore(Engine& engine, const RecordingReader::SnapshotRecord& snapshot)
+{
+    ByteReader in(snapshot.state, snapshot.size);
+    if (!engine.readState(in))
+    {
+        return false;
+    }
+    m_frame = snapshot.frame;
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Engine.h"
+#include "Recording.h"
+#include <cstdint>
+#include <functional>
+using namespace std;
+
+// Plays a recording back through an engine. The engine runs the recorded
+// frames exactly as it ran them while recording: the same spawns, the same
+// frame times, through the same advance. Given the same settings it ends up
+// in the same state, bit for bit, which verification checks against the
+// checksums and snapshots recorded along the way.
+class Replay
+{
+public:
+    struct Report
+    {
+        uint64_t frames = 0;          // Frames played
+        uint64_t checks = 0;          // Recorded checksums compared
+        uint64_t mismatches = 0;
+        uint64_t firstMismatch = 0;   // Frame of the first mismatch, 0 if none
+        double seconds = 0.0;         // Wall time spent playing
+    };
+
+    explicit Replay(const RecordingReader& recording);
+
+    // A headless engine, the size of the recorded screen, must be given the
+    // recorded settings before playing. Restores frame 0.
+    bool start(Engine& engine);
+
+    // Restore the latest snapshot at or before frame and play on to it.
+    // False if the recording does not reach frame.
+    bool seek(Engine& engine, uint64_t frame);
+
+    // Play up to frames more frames, or to the end of the recording. With
+    // verify, compare the state to every checksum and snapshot recorded
+    // for the frames played. afterFrame, if given, is called after every
+    // frame with how far into the last step to draw it.
+    Report play(Engine& engine, uint64_t frames, bool verify, const function<void(float)>& afterFrame = nullptr);
+
+    // The frame the engine's state is at
+    uint64_t frame() const { return m_frame; }
+
+private:
+    const RecordingReader& m_recording;
+    uint64_t m_frame;
+
+    // Returns the engine's alpha for drawing the frame
+    float playFrame(Engine& engine);
+    bool restore(Engine& engine, const RecordingReader::SnapshotRecord& snapshot);
+};
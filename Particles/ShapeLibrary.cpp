@@ -0,0 +1,142 @@
+#include "ShapeLibrary.h"
+#include <algorithm>
+#include <cmath>
+
+const int ShapeLibrary::kMinRadius;
+const int ShapeLibrary::kMaxRadius;
+const size_t EmitterConfig::kMaxPrebuiltShapes;
+
+const char* shapeSourceName(ShapeSource source)
+{
+    switch (source)
+    {
+    case ShapeSource::Generated: return "generated";
+    case ShapeSource::Tables: return "tables";
+    case ShapeSource::Prebuilt: return "prebuilt";
+    }
+    return "unknown";
+}
+
+bool parseShapeSource(const string& name, ShapeSource& source)
+{
+    const ShapeSource sources[] = { ShapeSource::Generated, ShapeSource::Tables, ShapeSource::Prebuilt };
+    for (ShapeSource candidate : sources)
+    {
+        if (name == shapeSourceName(candidate))
+        {
+            source = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+EmitterConfig withPointRange(const EmitterConfig& emitter, int minPoints, int maxPoints)
+{
+    EmitterConfig result = emitter;
+    if (minPoints >= 2 && maxPoints >= minPoints)
+    {
+        result.minPoints = minPoints;
+        result.maxPoints = maxPoints;
+    }
+    return result;
+}
+
+const vector<double>& ShapeLibrary::table(int numPoints)
+{
+    if (numPoints >= static_cast<int>(m_tables.size()))
+    {
+        m_tables.resize(numPoints + 1);
+    }
+    vector<double>& t = m_tables[numPoints];
+    if (t.empty() && numPoints > 0)
+    {
+        t.resize(2 * numPoints);
+        const double dTheta = 2.0 * M_PI / (numPoints > 1 ? (numPoints - 1) : 1);
+        for (int j = 0; j < numPoints; j++)
+        {
+            t[j] = cos(j * dTheta);
+            t[numPoints + j] = sin(j * dTheta);
+        }
+    }
+    return t;
+}
+
+void ShapeLibrary::generate(int numPoints, Random& random, ParticleScalar* x, ParticleScalar* y)
+{
+    const double* c = cosTable(numPoints);
+    const double* s = sinTable(numPoints);
+
+    // Radii in one batch, parked in x until used
+    random.fillInt(x, numPoints, kMinRadius, kMaxRadius);
+    for (int j = 0; j < numPoints; j++)
+    {
+        const double r = x[j];
+        x[j] = static_cast<ParticleScalar>(r * c[j]);
+        y[j] = static_cast<ParticleScalar>(r * s[j]);
+    }
+}
+
+int ShapeLibrary::prebuiltShape(size_t count, int minPoints, int maxPoints, Random& random)
+{
+    const int numPoints = random.uniformInt(minPoints, maxPoints);
+    const size_t range = static_cast<size_t>(maxPoints - minPoints) + 1;
+    const size_t perCount = max<size_t>(1, (count + range - 1) / range);
+    if (numPoints >= static_cast<int>(m_byPoints.size()))
+    {
+        m_byPoints.resize(numPoints + 1);
+    }
+    vector<int>& ids = m_byPoints[numPoints];
+    while (ids.size() < perCount)
+    {
+        const int offset = static_cast<int>(m_x.size());
+        m_x.resize(offset + numPoints);
+        m_y.resize(offset + numPoints);
+        generate(numPoints, random, &m_x[offset], &m_y[offset]);
+        ids.push_back(static_cast<int>(m_shapeOffset.size()));
+        m_shapeOffset.push_back(offset);
+        m_shapePoints.push_back(numPoints);
+    }
+    return ids[random.uniformInt(0, static_cast<int>(perCount) - 1)];
+}
+
+void ShapeLibrary::writePool(ByteWriter& out) const
+{
+    out.array(m_x);
+    out.array(m_y);
+    out.array(m_shapeOffset);
+    out.array(m_shapePoints);
+}
+
+bool ShapeLibrary::readPool(ByteReader& in)
+{
+    bool ok = in.array(m_x) && in.array(m_y) && in.array(m_shapeOffset) && in.array(m_shapePoints)
+        && m_shapeOffset.size() == m_shapePoints.size();
+
+    // Every shape must lie inside the coordinates. The index by vertex count
+    // is rebuilt in id order, the order the shapes were built in.
+    m_byPoints.clear();
+    for (size_t id = 0; id < m_shapeOffset.size() && ok; id++)
+    {
+        const int numPoints = m_shapePoints[id];
+        ok = m_shapeOffset[id] >= 0 && numPoints >= 2
+            && static_cast<size_t>(m_shapeOffset[id]) + numPoints <= min(m_x.size(), m_y.size());
+        if (ok)
+        {
+            if (numPoints >= static_cast<int>(m_byPoints.size()))
+            {
+                m_byPoints.resize(numPoints + 1);
+            }
+            m_byPoints[numPoints].push_back(static_cast<int>(id));
+        }
+    }
+    if (!ok)
+    {
+        m_x.clear();
+        m_y.clear();
+        m_shapeOffset.clear();
+        m_shapePoints.clear();
+        m_byPoints.clear();
+    }
+    return ok;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ByteStream.h"
+#include "Precision.h"
+#include "Random.h"
+using namespace std;
+
+// Where an emitter's particles get their shapes from
+enum class ShapeSource
+{
+    Generated, // cos and sin for every vertex of every particle, as Particle does
+    Tables,    // Random radii along cached unit directions: no trig per spawn
+    Prebuilt   // A shape from a pool built in advance, shared by reference
+};
+
+// "generated", "tables" or "prebuilt"
+const char* shapeSourceName(ShapeSource source);
+
+// Parse a name as printed by shapeSourceName; false if it is not one
+bool parseShapeSource(const string& name, ShapeSource& source);
+
+// Settings of one particle emitter
+struct EmitterConfig
+{
+    ShapeSource shapes = ShapeSource::Tables;
+    int minPoints = 25;          // Vertex count range of new particles
+    int maxPoints = 50;
+    size_t prebuiltShapes = 256; // Pool size used with ShapeSource::Prebuilt; 0 uses the tables
+
+    static const size_t kMaxPrebuiltShapes = 65536;
+};
+
+// The emitter with vertex counts in [minPoints, maxPoints] instead, for a
+// single spawn. A range of 0s, or one that is not valid, keeps the emitter's.
+EmitterConfig withPointRange(const EmitterConfig& emitter, int minPoints, int maxPoints);
+
+// Shape geometry shared by every particle.
+// Particle shapes only differ in their vertex count and a random radius per
+// vertex, so the directions of the vertices are computed once per vertex count
+// and reused. The library can also hold a pool of complete random shapes that
+// particles refer to by id; their own rotation and scale live in their pose.
+// Shapes are in coordinates local to the particle's center, starting at angle 0.
+class ShapeLibrary
+{
+public:
+    static const int kMinRadius = 20;
+    static const int kMaxRadius = 80;
+
+    // cos and sin of the direction of each vertex of a numPoints shape, the
+    // same spacing as Particle's: the first and last vertex coincide.
+    // Built on first use, so not safe to call from several threads at once.
+    const double* cosTable(int numPoints) { return table(numPoints).data(); }
+    const double* sinTable(int numPoints) { return table(numPoints).data() + numPoints; }
+
+    // Write a new random shape of numPoints vertices to x and y
+    void generate(int numPoints, Random& random, ParticleScalar* x, ParticleScalar* y);
+
+    // The id of a random prebuilt shape of minPoints to maxPoints vertices, for
+    // a pool of count shapes over that range: the vertex count is drawn first,
+    // then one of the count / range shapes of it, built the first time it is
+    // drawn. Shapes are never removed, so ids stay valid.
+    int prebuiltShape(size_t count, int minPoints, int maxPoints, Random& random);
+
+    // Save and restore the prebuilt pool; the tables are rebuilt on demand
+    void writePool(ByteWriter& out) const;
+    bool readPool(ByteReader& in);
+
+    size_t poolSize() const { return m_shapeOffset.size(); }
+    const ParticleScalar* shapeX(int id) const { return m_x.data() + m_shapeOffset[id]; }
+    const ParticleScalar* shapeY(int id) const { return m_y.data() + m_shapeOffset[id]; }
+    int shapePoints(int id) const { return m_shapePoints[id]; }
+
+private:
+    vector<vector<double>> m_tables;  // Per vertex count: the cos table, then the sin table
+
+    // Prebuilt shapes, packed one after the other
+    vector<ParticleScalar> m_x;
+    vector<ParticleScalar> m_y;
+    vector<int> m_shapeOffset;
+    vector<int> m_shapePoints;
+    vector<vector<int>> m_byPoints;   // Per vertex count: ids of the shapes with it
+
+    const vector<double>& table(int numPoints);
+};
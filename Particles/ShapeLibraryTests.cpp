@@ -0,0 +1,57 @@
+#include "Tests.h"
+#include "ParticleSystem.h"
+
+bool testShapes()
+{
+    // Spawned at the middle of the target, so centered on the origin: every
+    // vertex must sit at a whole radius from it, one direction step apart
+    ParticleSystem shaped;
+    Random shapeRandom(13);
+    EmitterConfig tables;
+    tables.shapes = ShapeSource::Tables;
+    EmitterConfig prebuilt;
+    prebuilt.shapes = ShapeSource::Prebuilt;
+    prebuilt.prebuiltShapes = 1;
+    prebuilt.minPoints = 30;
+    prebuilt.maxPoints = 30;
+    shaped.spawn(Vector2u(1920, 1080), tables, Vector2i(960, 540), shapeRandom);
+    shaped.spawn(Vector2u(1920, 1080), prebuilt, Vector2i(960, 540), shapeRandom);
+    shaped.spawn(Vector2u(1920, 1080), prebuilt, Vector2i(960, 540), shapeRandom);
+    bool shapesPassed = shaped.vertexCapacity() == static_cast<size_t>(shaped.particleVertexCount(0))
+        && shaped.particleVertexCount(1) == shaped.particleVertexCount(2);
+    // A spawn's own range picks prebuilt shapes inside it, and an empty pool
+    // falls back to the tables, vertices in the pool
+    ParticleSystem rangedShapes;
+    EmitterConfig noPool = prebuilt;
+    noPool.prebuiltShapes = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        rangedShapes.spawn(Vector2u(1920, 1080), withPointRange(prebuilt, 4, 6), Vector2i(960, 540), shapeRandom);
+        shapesPassed = shapesPassed && rangedShapes.particleVertexCount(i) >= 4 && rangedShapes.particleVertexCount(i) <= 6;
+    }
+    shapesPassed = shapesPassed && rangedShapes.vertexCapacity() == 0;
+    rangedShapes.spawn(Vector2u(1920, 1080), noPool, Vector2i(960, 540), shapeRandom);
+    shapesPassed = shapesPassed && rangedShapes.vertexCapacity() == 30;
+    ParticleScalar shapeX[50], shapeY[50], otherX[50], otherY[50];
+    shaped.worldVertices(0, shapeX, shapeY);
+    const int shapePoints = shaped.particleVertexCount(0);
+    const double step = 2.0 * M_PI / (shapePoints - 1);
+    for (int j = 0; j < shapePoints && shapesPassed; j++)
+    {
+        double r = hypot(shapeX[j], shapeY[j]);
+        shapesPassed = r >= 20.0 && r <= 80.0 && almostEqual(r, round(r));
+        if (j > 0)
+        {
+            double turn = atan2(shapeX[j - 1] * shapeY[j] - shapeY[j - 1] * shapeX[j], shapeX[j - 1] * shapeX[j] + shapeY[j - 1] * shapeY[j]);
+            shapesPassed = shapesPassed && almostEqual(turn, step);
+        }
+    }
+    shaped.worldVertices(1, shapeX, shapeY);
+    shaped.worldVertices(2, otherX, otherY);
+    for (int j = 0; j < shaped.particleVertexCount(1) && shapesPassed; j++)
+    {
+        // Same prebuilt shape, each with its own rotation
+        shapesPassed = almostEqual(hypot(shapeX[j], shapeY[j]), hypot(otherX[j], otherY[j]));
+    }
+    return shapesPassed;
+}
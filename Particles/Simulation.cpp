@@ -0,0 +1,130 @@
+#include "Simulation.h"
+#include <algorithm>
+
+const size_t Simulation::kRequests;
+const int Simulation::kMaxLateTicks;
+
+Simulation::Simulation(const ParticleSystem& particles, const Random& random, const EmitterConfig& emitter,
+                       double tickSeconds, unsigned updateThreads)
+    : m_particles(particles), m_random(random), m_emitter(emitter), m_tickSeconds(tickSeconds),
+      m_pool(updateThreads == 1 ? nullptr : new ThreadPool(updateThreads)),
+      m_requestHead(0), m_requestTail(0), m_running(false), m_ticks(0), m_droppedTicks(0)
+{
+    // The reader starts out with the initial state, so it has something to draw
+    m_particles.copyStateTo(m_snapshots.front().particles);
+    m_snapshots.front().time = Clock::now();
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::start()
+{
+    if (!m_running.exchange(true))
+    {
+        m_thread = thread(&Simulation::loop, this);
+    }
+}
+
+void Simulation::stop()
+{
+    if (m_running.exchange(false))
+    {
+        m_thread.join();
+    }
+}
+
+bool Simulation::requestSpawn(Vector2i position, int count, Vector2u targetSize, int minPoints, int maxPoints)
+{
+    Request request;
+    request.kind = Request::Spawn;
+    request.position = position;
+    request.targetSize = targetSize;
+    request.count = count;
+    request.minPoints = minPoints;
+    request.maxPoints = maxPoints;
+    return push(request);
+}
+
+bool Simulation::requestViewport(const FloatRect& viewport)
+{
+    Request request;
+    request.kind = Request::Viewport;
+    request.viewport = viewport;
+    return push(request);
+}
+
+bool Simulation::push(const Request& request)
+{
+    const size_t tail = m_requestTail.load(memory_order_relaxed);
+    if (tail - m_requestHead.load(memory_order_acquire) == kRequests)
+    {
+        return false;
+    }
+    m_requests[tail & (kRequests - 1)] = request;
+    m_requestTail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+float Simulation::alpha(Clock::time_point now)
+{
+    // The latest tick was due at latest().time, the one before a tick earlier.
+    // Drawing a tick in the past puts now exactly between the two.
+    const double behind = chrono::duration<double>(now - latest().time).count();
+    return static_cast<float>(min(1.0, max(0.0, behind / m_tickSeconds)));
+}
+
+void Simulation::loop()
+{
+    const Clock::duration tickDuration = chrono::duration_cast<Clock::duration>(chrono::duration<double>(m_tickSeconds));
+    Clock::time_point due = Clock::now() + tickDuration;
+    while (m_running.load(memory_order_relaxed))
+    {
+        this_thread::sleep_until(due);
+
+        // A spike made us miss more than a few ticks: give up on them rather
+        // than spiral into catching up
+        const Clock::time_point now = Clock::now();
+        if (now - due > kMaxLateTicks * tickDuration)
+        {
+            const uint64_t missed = static_cast<uint64_t>((now - due) / tickDuration);
+            m_droppedTicks.fetch_add(missed, memory_order_relaxed);
+            due += missed * tickDuration;
+        }
+
+        tick();
+        Snapshot& snapshot = m_snapshots.back();
+        m_particles.copyStateTo(snapshot.particles);
+        snapshot.time = due;
+        snapshot.tick = m_ticks.fetch_add(1, memory_order_relaxed) + 1;
+        m_snapshots.publish();
+
+        due += tickDuration;
+    }
+}
+
+void Simulation::tick()
+{
+    // Requests made since the last tick, in order, then one fixed step
+    const size_t tail = m_requestTail.load(memory_order_acquire);
+    size_t head = m_requestHead.load(memory_order_relaxed);
+    for (; head != tail; head++)
+    {
+        const Request& request = m_requests[head & (kRequests - 1)];
+        if (request.kind == Request::Viewport)
+        {
+            m_particles.setViewport(request.viewport);
+            continue;
+        }
+        const EmitterConfig emitter = withPointRange(m_emitter, request.minPoints, request.maxPoints);
+        for (int i = 0; i < request.count; i++)
+        {
+            m_particles.spawn(request.targetSize, emitter, request.position, m_random);
+        }
+    }
+    m_requestHead.store(head, memory_order_release);
+
+    m_particles.update(static_cast<float>(m_tickSeconds), m_pool.get());
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "ParticleSystem.h"
+#include "Random.h"
+#include "ShapeLibrary.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+using namespace sf;
+using namespace std;
+
+// Runs the particle simulation on its own thread at a fixed tick rate.
+// After every tick the state is copied into a triple buffer, from which the
+// render thread takes the newest one whenever it likes: neither thread ever
+// waits for the other. Spawn and viewport requests travel the other way
+// through a small lock-free queue and take effect at the start of the next tick.
+// When the thread falls far behind, e.g. under a load spike, it drops the
+// missed time instead of running a burst of catch-up ticks.
+class Simulation
+{
+public:
+    typedef chrono::steady_clock Clock;
+
+    // State published after a tick
+    struct Snapshot
+    {
+        ParticleSystem particles;  // Poses at the end of the tick and before it
+        Clock::time_point time;    // When the tick was due
+        uint64_t tick = 0;
+    };
+
+    // Simulate particles, spawned with random and emitter, in ticks of
+    // tickSeconds, updating on updateThreads threads as Engine::setUpdateThreads
+    // counts them. The workers are the simulation's own: a pool only runs one
+    // parallelFor at a time, so it cannot share the render thread's.
+    Simulation(const ParticleSystem& particles, const Random& random, const EmitterConfig& emitter,
+               double tickSeconds, unsigned updateThreads = 1);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void start();
+    void stop();
+
+    // Render thread: queue a spawn for the next tick, with vertex counts in
+    // [minPoints, maxPoints] (see withPointRange). Returns false, dropping the
+    // request, if the queue is full.
+    bool requestSpawn(Vector2i position, int count, Vector2u targetSize, int minPoints = 0, int maxPoints = 0);
+
+    // Render thread: queue a new viewport, e.g. after a resize, for the next
+    // tick to cull and retire against. Returns false, dropping it, if the
+    // queue is full.
+    bool requestViewport(const FloatRect& viewport);
+
+    // Render thread: take the newest snapshot if one was published since the
+    // last call; the snapshot is the caller's until the next call
+    bool acquire() { return m_snapshots.acquire(); }
+    Snapshot& latest() { return m_snapshots.front(); }
+
+    // Render thread: how far between the latest snapshot's previous and
+    // current poses to draw at time now, for drawing one tick in the past
+    float alpha(Clock::time_point now);
+
+    double getTickSeconds() const { return m_tickSeconds; }
+    uint64_t getTickCount() const { return m_ticks.load(memory_order_relaxed); }
+    uint64_t getDroppedTicks() const { return m_droppedTicks.load(memory_order_relaxed); }
+
+private:
+    static const size_t kRequests = 1024;     // Spawn queue capacity, a power of two
+    static const int kMaxLateTicks = 5;       // Further behind than this, drop time
+
+    // A spawn, or a new viewport
+    struct Request
+    {
+        enum Kind { Spawn, Viewport } kind;
+        Vector2i position;
+        Vector2u targetSize;
+        int count;
+        int minPoints;
+        int maxPoints;
+        FloatRect viewport;
+    };
+
+    ParticleSystem m_particles;               // Owned by the simulation thread
+    Random m_random;
+    EmitterConfig m_emitter;
+    const double m_tickSeconds;
+    unique_ptr<ThreadPool> m_pool;            // Null when updating on the simulation thread alone
+
+    TripleBuffer<Snapshot> m_snapshots;
+
+    Request m_requests[kRequests];       // Single producer, single consumer ring
+    atomic<size_t> m_requestHead;             // Next request to run
+    atomic<size_t> m_requestTail;             // Next free entry
+
+    thread m_thread;
+    atomic<bool> m_running;
+    atomic<uint64_t> m_ticks;
+    atomic<uint64_t> m_droppedTicks;
+
+    bool push(const Request& request);
+    void loop();
+    void tick();
+};
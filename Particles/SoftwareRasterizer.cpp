@@ -0,0 +1,328 @@
+#include "SoftwareRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int SoftwareRasterizer::kTileSize;
+
+namespace
+{
+    // Round an interpolated channel to 8 bits
+    inline Uint8 channel(float value)
+    {
+        return static_cast<Uint8>(min(255.0f, max(0.0f, value)) + 0.5f);
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer() : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0)
+{
+}
+
+void SoftwareRasterizer::resize(unsigned width, unsigned height)
+{
+    if (width == m_width && height == m_height)
+    {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    m_tilesX = static_cast<int>((width + kTileSize - 1) / kTileSize);
+    m_tilesY = static_cast<int>((height + kTileSize - 1) / kTileSize);
+    m_pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    m_bins.clear();
+}
+
+void SoftwareRasterizer::clear(Color color)
+{
+    if (m_pixels.empty())
+    {
+        return;
+    }
+    // One row by hand, then whole rows at a time
+    const Uint8 pixel[4] = { color.r, color.g, color.b, color.a };
+    const size_t row = static_cast<size_t>(m_width) * 4;
+    for (size_t i = 0; i < row; i += 4)
+    {
+        memcpy(&m_pixels[i], pixel, 4);
+    }
+    for (unsigned y = 1; y < m_height; y++)
+    {
+        memcpy(&m_pixels[y * row], &m_pixels[0], row);
+    }
+}
+
+Color SoftwareRasterizer::getPixel(unsigned x, unsigned y) const
+{
+    const Uint8* p = &m_pixels[(static_cast<size_t>(y) * m_width + x) * 4];
+    return Color(p[0], p[1], p[2], p[3]);
+}
+
+void SoftwareRasterizer::draw(const Vertex* vertices, size_t count, const Transform& transform, ThreadPool* pool)
+{
+    const size_t triangles = count / 3;
+    const int tiles = m_tilesX * m_tilesY;
+    if (triangles == 0 || tiles == 0)
+    {
+        return;
+    }
+    m_triangles.resize(triangles);
+
+    // Batches of binning keep the draw order, so their number is free to
+    // follow the thread count
+    const size_t batches = pool ? pool->getThreadCount() : 1;
+    if (m_bins.size() != batches)
+    {
+        m_bins.assign(batches, vector<vector<uint32_t>>(tiles));
+    }
+
+    if (pool)
+    {
+        pool->parallelFor(triangles, 4096, [&](size_t begin, size_t end) {
+            setupRange(vertices, transform, begin, end);
+        });
+        pool->parallelFor(batches, 1, [&](size_t begin, size_t end) {
+            for (size_t batch = begin; batch < end; batch++)
+            {
+                binRange(batch, triangles * batch / batches, triangles * (batch + 1) / batches);
+            }
+        });
+        pool->parallelFor(static_cast<size_t>(tiles), 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+            {
+                fillTile(static_cast<int>(tile));
+            }
+        });
+    }
+    else
+    {
+        setupRange(vertices, transform, 0, triangles);
+        binRange(0, 0, triangles);
+        for (int tile = 0; tile < tiles; tile++)
+        {
+            fillTile(tile);
+        }
+    }
+}
+
+void SoftwareRasterizer::setupRange(const Vertex* vertices, const Transform& transform, size_t begin, size_t end)
+{
+    for (size_t t = begin; t < end; t++)
+    {
+        Setup& s = m_triangles[t];
+        const Vertex* v = vertices + 3 * t;
+        Vector2f p[3] = { transform.transformPoint(v[0].position), transform.transformPoint(v[1].position),
+                          transform.transformPoint(v[2].position) };
+        Color color[3] = { v[0].color, v[1].color, v[2].color };
+
+        // Wind every triangle the same way, so its inside is on the positive
+        // side; area is twice the triangle's
+        double area = (static_cast<double>(p[1].x) - p[0].x) * (static_cast<double>(p[2].y) - p[0].y)
+            - (static_cast<double>(p[1].y) - p[0].y) * (static_cast<double>(p[2].x) - p[0].x);
+        if (area < 0.0)
+        {
+            swap(p[1], p[2]);
+            swap(color[1], color[2]);
+            area = -area;
+        }
+
+        const double minX = min(p[0].x, min(p[1].x, p[2].x));
+        const double maxX = max(p[0].x, max(p[1].x, p[2].x));
+        const double minY = min(p[0].y, min(p[1].y, p[2].y));
+        const double maxY = max(p[0].y, max(p[1].y, p[2].y));
+
+        // Pixels whose centers fall in the bounds, on screen; none for a
+        // triangle without area, or with coordinates that are not numbers
+        s.x0 = 1;
+        s.x1 = 0;
+        if (!(area > 0.0) || !(maxX >= 0.0 && minX <= m_width && maxY >= 0.0 && minY <= m_height))
+        {
+            continue;
+        }
+        s.x0 = static_cast<int>(ceil(max(minX, 0.0) - 0.5));
+        s.x1 = min(static_cast<int>(m_width) - 1, static_cast<int>(floor(min(maxX, m_width + 1.0) - 0.5)));
+        s.y0 = static_cast<int>(ceil(max(minY, 0.0) - 0.5));
+        s.y1 = min(static_cast<int>(m_height) - 1, static_cast<int>(floor(min(maxY, m_height + 1.0) - 0.5)));
+
+        s.topLeft = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const Vector2f& from = p[k];
+            const Vector2f& to = p[(k + 1) % 3];
+            s.a[k] = static_cast<double>(from.y) - to.y;
+            s.b[k] = static_cast<double>(to.x) - from.x;
+            s.c[k] = static_cast<double>(from.x) * to.y - static_cast<double>(to.x) * from.y;
+
+            // Of the two windings of an edge, exactly one passes this test
+            if (s.a[k] > 0.0 || (s.a[k] == 0.0 && s.b[k] < 0.0))
+            {
+                s.topLeft |= 1 << k;
+            }
+        }
+
+        // Each channel is the plane through the three vertices' values
+        s.ox = p[0].x;
+        s.oy = p[0].y;
+        const double dx1 = static_cast<double>(p[1].x) - p[0].x, dy1 = static_cast<double>(p[1].y) - p[0].y;
+        const double dx2 = static_cast<double>(p[2].x) - p[0].x, dy2 = static_cast<double>(p[2].y) - p[0].y;
+        const Uint8* c[3] = { &color[0].r, &color[1].r, &color[2].r };
+        for (int n = 0; n < 4; n++)
+        {
+            const double d1 = static_cast<double>(c[1][n]) - c[0][n];
+            const double d2 = static_cast<double>(c[2][n]) - c[0][n];
+            s.cx[n] = static_cast<float>((d1 * dy2 - d2 * dy1) / area);
+            s.cy[n] = static_cast<float>((d2 * dx1 - d1 * dx2) / area);
+            s.c0[n] = c[0][n];
+        }
+        s.opaque = color[0].a == 255 && color[1].a == 255 && color[2].a == 255;
+    }
+}
+
+void SoftwareRasterizer::binRange(size_t batch, size_t begin, size_t end)
+{
+    vector<vector<uint32_t>>& bins = m_bins[batch];
+    for (vector<uint32_t>& bin : bins)
+    {
+        bin.clear();
+    }
+    for (size_t t = begin; t < end; t++)
+    {
+        const Setup& s = m_triangles[t];
+        if (s.x0 > s.x1 || s.y0 > s.y1)
+        {
+            continue;
+        }
+        for (int ty = s.y0 / kTileSize; ty <= s.y1 / kTileSize; ty++)
+        {
+            for (int tx = s.x0 / kTileSize; tx <= s.x1 / kTileSize; tx++)
+            {
+                bins[ty * m_tilesX + tx].push_back(static_cast<uint32_t>(t));
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::fillTile(int tile)
+{
+    const int x0 = (tile % m_tilesX) * kTileSize;
+    const int y0 = (tile / m_tilesX) * kTileSize;
+    const int x1 = min(x0 + kTileSize, static_cast<int>(m_width)) - 1;
+    const int y1 = min(y0 + kTileSize, static_cast<int>(m_height)) - 1;
+    for (const vector<vector<uint32_t>>& bins : m_bins)
+    {
+        for (uint32_t t : bins[tile])
+        {
+            const Setup& s = m_triangles[t];
+            fillTriangle(s, max(x0, s.x0), max(y0, s.y0), min(x1, s.x1), min(y1, s.y1));
+        }
+    }
+}
+
+void SoftwareRasterizer::fillTriangle(const Setup& s, int x0, int y0, int x1, int y1)
+{
+    // Edges going up bound rows on the left (the inside grows with x), edges
+    // going down on the right. Where an edge crosses a row moves by a fixed
+    // step per row, and is known to far better than a pixel: only a center
+    // that lies about on the edge needs the exact test, which settles ties
+    // the same way for both triangles sharing the edge.
+    const double kNear = 1e-6;
+    double crossing[3];
+    double step[3];
+    const double firstY = y0 + 0.5;
+    for (int k = 0; k < 3; k++)
+    {
+        if (s.a[k] != 0.0)
+        {
+            // The x whose pixel center is on the edge
+            crossing[k] = -(s.b[k] * firstY + s.c[k]) / s.a[k] - 0.5;
+            step[k] = -s.b[k] / s.a[k];
+        }
+    }
+    auto inside = [&s](int k, int x, double centerY) {
+        const double e = s.a[k] * (x + 0.5) + s.b[k] * centerY + s.c[k];
+        return e > 0.0 || (e == 0.0 && (s.topLeft >> k & 1));
+    };
+
+    for (int y = y0; y <= y1; y++)
+    {
+        const double centerY = y + 0.5;
+        int lo = x0;
+        int hi = x1;
+        for (int k = 0; k < 3; k++)
+        {
+            if (s.a[k] == 0.0)
+            {
+                // A horizontal edge takes or leaves whole rows
+                if (!inside(k, x0, centerY))
+                {
+                    hi = lo - 1;
+                }
+                continue;
+            }
+            // Clamped to at least -2, where adding 4 before truncating floors
+            const double t = min(max(crossing[k], x0 - 2.0), x1 + 2.0) + 4.0;
+            const int whole = static_cast<int>(t);
+            const double fraction = t - whole;
+            crossing[k] += step[k];
+            int x = whole - 4;
+            if (fraction < kNear || fraction > 1.0 - kNear)
+            {
+                // About on a center: the exact test decides that pixel
+                x += fraction > 0.5;
+                if (s.a[k] > 0.0)
+                {
+                    lo = max(lo, inside(k, x, centerY) ? x : x + 1);
+                }
+                else
+                {
+                    hi = min(hi, inside(k, x, centerY) ? x : x - 1);
+                }
+            }
+            else if (s.a[k] > 0.0)
+            {
+                lo = max(lo, x + 1);
+            }
+            else
+            {
+                hi = min(hi, x);
+            }
+        }
+        if (lo > hi)
+        {
+            continue;
+        }
+
+        // Locals, not the setup's fields: the pixel stores could alias those
+        const float fromX = lo + 0.5f - s.ox;
+        const float fromY = static_cast<float>(centerY) - s.oy;
+        float r = s.c0[0] + s.cx[0] * fromX + s.cy[0] * fromY;
+        float g = s.c0[1] + s.cx[1] * fromX + s.cy[1] * fromY;
+        float b = s.c0[2] + s.cx[2] * fromX + s.cy[2] * fromY;
+        float a = s.c0[3] + s.cx[3] * fromX + s.cy[3] * fromY;
+        const float dr = s.cx[0], dg = s.cx[1], db = s.cx[2], da = s.cx[3];
+        Uint8* pixel = &m_pixels[(static_cast<size_t>(y) * m_width + lo) * 4];
+        Uint8* const end = pixel + 4 * (hi - lo + 1);
+        if (s.opaque)
+        {
+            for (; pixel != end; pixel += 4, r += dr, g += dg, b += db)
+            {
+                pixel[0] = channel(r);
+                pixel[1] = channel(g);
+                pixel[2] = channel(b);
+                pixel[3] = 255;
+            }
+            continue;
+        }
+        for (; pixel != end; pixel += 4, r += dr, g += dg, b += db, a += da)
+        {
+            // BlendAlpha: source color by its alpha over the destination,
+            // alpha added over what remains
+            const Uint8 sourceAlpha = channel(a);
+            const float alpha = sourceAlpha * (1.0f / 255.0f);
+            const float keep = 1.0f - alpha;
+            pixel[0] = channel(channel(r) * alpha + pixel[0] * keep);
+            pixel[1] = channel(channel(g) * alpha + pixel[1] * keep);
+            pixel[2] = channel(channel(b) * alpha + pixel[2] * keep);
+            pixel[3] = channel(sourceAlpha + pixel[3] * keep);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+using namespace sf;
+using namespace std;
+
+// Draws triangle lists into an RGBA framebuffer in memory, for rendering
+// without a GPU or a display.
+// It follows the rules OpenGL rasterizes SFML's triangles by, so frames come
+// out as a window would show them, give or take rounding at the edges:
+// - a pixel is covered when its center is inside a triangle
+// - a center exactly on an edge goes to one triangle of the two sharing it
+// - vertex colors are interpolated linearly across the triangle
+// - triangles blend over what is drawn in list order, as BlendAlpha does
+//
+// The screen is cut into square tiles. Each triangle is first filed into the
+// tiles it overlaps, then the tiles are filled in parallel, each by one
+// thread going through its triangles in list order. Every pixel is written by
+// one thread only, so no locking is needed, and the result is the same
+// whatever the thread count.
+class SoftwareRasterizer
+{
+public:
+    static const int kTileSize = 64;
+
+    SoftwareRasterizer();
+
+    // Size the framebuffer; the content is undefined until the next clear
+    void resize(unsigned width, unsigned height);
+
+    void clear(Color color = Color::Black);
+
+    // Draw count vertices, a list of triangles, mapped to pixels by transform.
+    // With a pool, the setup and the tiles are spread over its threads.
+    void draw(const Vertex* vertices, size_t count, const Transform& transform, ThreadPool* pool = nullptr);
+
+    unsigned getWidth() const { return m_width; }
+    unsigned getHeight() const { return m_height; }
+
+    // Rows from the top, 4 bytes per pixel in RGBA order, as sf::Image takes them
+    const Uint8* getPixels() const { return m_pixels.data(); }
+    Color getPixel(unsigned x, unsigned y) const;
+
+private:
+    // A triangle in pixels, ready to fill. Edge k runs from vertex k to the
+    // next, with a * x + b * y + c >= 0 on the inside. The edges are in double
+    // precision, where a triangle's edge is exactly the negative of its
+    // neighbor's, so a pixel center on it goes to exactly one of them.
+    // Color channel n is c0[n] + cx[n] * (x - ox) + cy[n] * (y - oy).
+    struct Setup
+    {
+        double a[3], b[3], c[3];
+        float ox, oy;
+        float cx[4], cy[4], c0[4];
+        int x0, y0, x1, y1;           // Pixels the triangle may cover, inclusive; x0 > x1 if none
+        uint8_t topLeft;              // Bit k: pixel centers on edge k are inside
+        bool opaque;                  // All three colors fully opaque
+    };
+
+    unsigned m_width;
+    unsigned m_height;
+    int m_tilesX;
+    int m_tilesY;
+    vector<Uint8> m_pixels;
+
+    vector<Setup> m_triangles;        // One per input triangle, in draw order
+
+    // Triangles are filed into tiles in a few contiguous batches, one per
+    // thread; a tile goes through its triangles batch by batch, which keeps
+    // the draw order. The lists keep their capacity from frame to frame.
+    vector<vector<vector<uint32_t>>> m_bins; // [batch][tile] -> triangles
+
+    // Set up triangles [begin, end) of vertices
+    void setupRange(const Vertex* vertices, const Transform& transform, size_t begin, size_t end);
+    void binRange(size_t batch, size_t begin, size_t end);
+    void fillTile(int tile);
+    void fillTriangle(const Setup& triangle, int x0, int y0, int x1, int y1);
+};
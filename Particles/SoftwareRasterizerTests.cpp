@@ -0,0 +1,60 @@
+#include "Tests.h"
+#include "ParticleSystem.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+bool testSoftwareRasterizer()
+{
+    // Two half-transparent triangles sharing a diagonal cover a square once
+    // each, and colors blend linearly from corner to corner. Tiles filled in
+    // parallel give the same frame as tiles filled in turn.
+    SoftwareRasterizer raster;
+    raster.resize(100, 100);
+    raster.clear();
+    const Color half(255, 255, 255, 128);
+    const Vertex square[6] = { Vertex(Vector2f(10, 10), half), Vertex(Vector2f(50, 10), half), Vertex(Vector2f(50, 50), half),
+                               Vertex(Vector2f(10, 10), half), Vertex(Vector2f(50, 50), half), Vertex(Vector2f(10, 50), half) };
+    raster.draw(square, 6, Transform::Identity);
+    bool rasterPassed = raster.getPixel(9, 30) == Color::Black && raster.getPixel(50, 30) == Color::Black;
+    for (unsigned y = 10; y < 50 && rasterPassed; y++)
+    {
+        for (unsigned x = 10; x < 50 && rasterPassed; x++)
+        {
+            rasterPassed = raster.getPixel(x, y) == Color(128, 128, 128, 255);
+        }
+    }
+    raster.clear();
+    const Vertex ramp[3] = { Vertex(Vector2f(0, 0), Color::Black), Vertex(Vector2f(200, 0), Color(200, 0, 0)),
+                             Vertex(Vector2f(0, 200), Color::Black) };
+    raster.draw(ramp, 3, Transform::Identity);
+    rasterPassed = rasterPassed && raster.getPixel(10, 10).r == 11 && raster.getPixel(60, 30).r == 61;
+
+    ParticleSystem scene;
+    Random sceneRandom(8);
+    for (int i = 0; i < 200; i++)
+    {
+        scene.spawn(Vector2u(640, 480), 30, Vector2i(sceneRandom.uniformInt(0, 639), sceneRandom.uniformInt(0, 479)), sceneRandom);
+    }
+    const size_t sceneSize = scene.buildStream();
+    SoftwareRasterizer serial;
+    SoftwareRasterizer tiled;
+    ThreadPool rasterPool(3);
+    serial.resize(640, 480);
+    serial.clear();
+    serial.draw(scene.getStream(), sceneSize, cartesianToPixel(Vector2u(640, 480)));
+    tiled.resize(640, 480);
+    tiled.clear();
+    tiled.draw(scene.getStream(), sceneSize, cartesianToPixel(Vector2u(640, 480)), &rasterPool);
+    size_t litPixels = 0;
+    for (unsigned y = 0; y < 480; y++)
+    {
+        for (unsigned x = 0; x < 640; x++)
+        {
+            litPixels += serial.getPixel(x, y) != Color::Black;
+        }
+    }
+    rasterPassed = rasterPassed && sceneSize > 0 && litPixels > 640 * 480 / 4
+        && equal(serial.getPixels(), serial.getPixels() + 640 * 480 * 4, tiled.getPixels());
+    return rasterPassed;
+}
@@ -0,0 +1,84 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+
+namespace
+{
+    const size_t kBuildGrain = 4096; // Points per parallel chunk
+}
+
+SpatialGrid::SpatialGrid(float cellSize)
+    : m_mask(0)
+{
+    setCellSize(cellSize);
+}
+
+void SpatialGrid::setCellSize(float cellSize)
+{
+    m_cellSize = cellSize;
+    m_inverseCellSize = 1.0f / cellSize;
+    m_entries.clear();
+}
+
+void SpatialGrid::build(const Vector2f* points, size_t count, ThreadPool* pool)
+{
+    // At least two buckets per point keeps the chains short
+    size_t buckets = 1;
+    while (buckets < 2 * count)
+    {
+        buckets *= 2;
+    }
+    m_mask = buckets - 1;
+
+    // The cell and bucket of every point are independent of each other
+    m_pointCell.resize(count);
+    m_pointBucket.resize(count);
+    auto locate = [this, points](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            const int cx = cellOf(points[i].x);
+            const int cy = cellOf(points[i].y);
+            m_pointCell[i] = cellKey(cx, cy);
+            m_pointBucket[i] = static_cast<uint32_t>(bucketOf(cx, cy));
+        }
+    };
+    if (pool)
+    {
+        pool->parallelFor(count, kBuildGrain, locate);
+    }
+    else
+    {
+        locate(0, count);
+    }
+
+    // Counting sort by bucket. It is one linear pass each way, and doing it
+    // in order keeps every bucket's points in index order.
+    m_start.assign(buckets + 1, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        m_start[m_pointBucket[i] + 1]++;
+    }
+    for (size_t b = 0; b < buckets; b++)
+    {
+        m_start[b + 1] += m_start[b];
+    }
+    m_entries.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        // m_start[b] doubles as the fill position of bucket b ...
+        const uint32_t k = m_start[m_pointBucket[i]]++;
+        m_entries[k].cell = m_pointCell[i];
+        m_entries[k].point = points[i];
+        m_entries[k].index = static_cast<uint32_t>(i);
+    }
+    // ... so after the scatter it is the start of bucket b + 1: shift back
+    for (size_t b = buckets; b > 0; b--)
+    {
+        m_start[b] = m_start[b - 1];
+    }
+    m_start[0] = 0;
+}
+
+void SpatialGrid::query(Vector2f center, float radius, vector<uint32_t>& out) const
+{
+    forEachWithin(center, radius, [&out](uint32_t index) { out.push_back(index); });
+}
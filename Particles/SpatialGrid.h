@@ -0,0 +1,146 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "ShapeLibrary.h"
+#include "ThreadPool.h"
+using namespace sf;
+using namespace std;
+
+// Uniform spatial hash over a set of points, for neighbor and range queries.
+// The plane is cut into square cells, and the cells are hashed into a table
+// with at least twice as many buckets as points, so the index costs O(points)
+// wherever they are, with no bounds to fit. The points are sorted by bucket
+// into one flat array, keeping their original order within a bucket: queries
+// visit points in the same order whatever the thread count.
+// Cells next to each other in a row hash to consecutive buckets, so a query's
+// candidates sit in a few runs of memory rather than one miss per cell.
+//
+// Each point belongs to exactly one cell, and a bucket's points are filtered
+// by cell, so a query never reports a point twice even when cells collide in
+// the table. Queries only read the index, so any number may run in parallel.
+class SpatialGrid
+{
+public:
+    // Cells of cellSize units. Queries are cheapest when their range is about
+    // a cell, so that they look at 3 x 3 cells at most; the default fits
+    // queries for overlapping particles of the largest radius.
+    explicit SpatialGrid(float cellSize = 2.0f * ShapeLibrary::kMaxRadius);
+
+    void setCellSize(float cellSize);
+    float getCellSize() const { return m_cellSize; }
+
+    // Index count points. With a pool, the cells of the points are found in
+    // parallel; the result is the same either way.
+    void build(const Vector2f* points, size_t count, ThreadPool* pool = nullptr);
+
+    size_t size() const { return m_entries.size(); }
+
+    // The point stored k-th. Running queries for the points in this order,
+    // rather than in index order, keeps consecutive queries in cache.
+    uint32_t item(size_t k) const { return m_entries[k].index; }
+
+    // Call f(index) for every point within radius of center, in index order
+    // within each cell
+    template <typename F>
+    void forEachWithin(Vector2f center, float radius, F f) const
+    {
+        const float radius2 = radius * radius;
+        forEachCandidate(center.x - radius, center.y - radius, center.x + radius, center.y + radius,
+                         [&](uint32_t index, Vector2f p) {
+                             const float dx = p.x - center.x;
+                             const float dy = p.y - center.y;
+                             if (dx * dx + dy * dy <= radius2)
+                             {
+                                 f(index);
+                             }
+                         });
+    }
+
+    // Call f(index) for every point inside rect
+    template <typename F>
+    void forEachInRect(const FloatRect& rect, F f) const
+    {
+        const float right = rect.left + rect.width;
+        const float bottom = rect.top + rect.height;
+        forEachCandidate(rect.left, rect.top, right, bottom, [&](uint32_t index, Vector2f p) {
+            if (p.x >= rect.left && p.x <= right && p.y >= rect.top && p.y <= bottom)
+            {
+                f(index);
+            }
+        });
+    }
+
+    // Indices of the points within radius of center, appended to out
+    void query(Vector2f center, float radius, vector<uint32_t>& out) const;
+
+private:
+    float m_cellSize;
+    float m_inverseCellSize;
+    size_t m_mask;                  // Bucket count - 1, a power of two minus one
+
+    struct Entry
+    {
+        uint64_t cell;              // Packed cell coordinates
+        Vector2f point;
+        uint32_t index;
+    };
+
+    vector<uint32_t> m_start;       // First entry of each bucket, plus an end marker
+    vector<Entry> m_entries;        // The points, bucket by bucket
+
+    vector<uint64_t> m_pointCell;   // Scratch: cell of each input point
+    vector<uint32_t> m_pointBucket; // Scratch: bucket of each input point
+
+    int cellOf(float v) const { return static_cast<int>(floor(v * m_inverseCellSize)); }
+
+    static uint64_t cellKey(int cx, int cy)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    size_t bucketOf(int cx, int cy) const
+    {
+        return (static_cast<uint32_t>(cx) + static_cast<uint32_t>(cy) * 73856093u) & m_mask;
+    }
+
+    // Call visit(index, position) for every point in the cells overlapping
+    // [x0, x1] x [y0, y1]. A box with more cells than there are buckets scans
+    // every point instead.
+    template <typename V>
+    void forEachCandidate(float x0, float y0, float x1, float y1, V visit) const
+    {
+        if (m_entries.empty())
+        {
+            return;
+        }
+        const int cx0 = cellOf(x0), cx1 = cellOf(x1);
+        const int cy0 = cellOf(y0), cy1 = cellOf(y1);
+        const double cells = (static_cast<double>(cx1) - cx0 + 1) * (static_cast<double>(cy1) - cy0 + 1);
+        if (cells > static_cast<double>(m_mask + 1))
+        {
+            for (const Entry& entry : m_entries)
+            {
+                visit(entry.index, entry.point);
+            }
+            return;
+        }
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                const size_t bucket = bucketOf(cx, cy);
+                const uint64_t key = cellKey(cx, cy);
+                for (uint32_t k = m_start[bucket]; k < m_start[bucket + 1]; k++)
+                {
+                    const Entry& entry = m_entries[k];
+                    if (entry.cell == key)
+                    {
+                        visit(entry.index, entry.point);
+                    }
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,51 @@
+#include "Tests.h"
+#include "ParticleSystem.h"
+#include "SpatialGrid.h"
+
+bool testSpatialGrid()
+{
+    // The grid finds exactly the scattered a brute-force search does
+    Random gridRandom(8);
+    vector<Vector2f> scattered(500);
+    for (Vector2f& point : scattered)
+    {
+        point = Vector2f(static_cast<float>(gridRandom.uniform(-1000.0, 1000.0)), static_cast<float>(gridRandom.uniform(-1000.0, 1000.0)));
+    }
+    SpatialGrid grid;
+    grid.build(scattered.data(), scattered.size());
+    bool gridPassed = grid.size() == scattered.size();
+    vector<uint32_t> found;
+    for (size_t i = 0; i < scattered.size() && gridPassed; i += 7)
+    {
+        found.clear();
+        grid.query(scattered[i], 150.0f, found);
+        size_t expected = 0;
+        for (const Vector2f& other : scattered)
+        {
+            const Vector2f d = other - scattered[i];
+            expected += d.x * d.x + d.y * d.y <= 150.0f * 150.0f;
+        }
+        gridPassed = found.size() == expected;
+    }
+    // Two overlapping particles are pushed apart evenly, about the midpoint
+    // they would have had without colliding
+    CollisionConfig collisions;
+    collisions.enabled = true;
+    ParticleSystem colliding, passing;
+    colliding.setCollisions(collisions);
+    ParticleSystem* pair[] = { &colliding, &passing };
+    for (ParticleSystem* system : pair)
+    {
+        Random pairRandom(2);
+        system->spawn(Vector2u(1920, 1080), 30, Vector2i(900, 540), pairRandom);
+        system->spawn(Vector2u(1920, 1080), 30, Vector2i(1000, 540), pairRandom);
+        system->update(1.0f / 60.0f);
+    }
+    const Vector2f collided = colliding.position(1) - colliding.position(0);
+    const Vector2f passed = passing.position(1) - passing.position(0);
+    const Vector2f midpointShift = colliding.position(0) + colliding.position(1) - passing.position(0) - passing.position(1);
+    gridPassed = gridPassed && colliding.size() == 2 && hypot(passed.x, passed.y) < colliding.radius(0) + colliding.radius(1)
+        && hypot(collided.x, collided.y) > hypot(passed.x, passed.y) + 1.0
+        && almostEqual(midpointShift.x, 0.0, 0.01) && almostEqual(midpointShift.y, 0.0, 0.01);
+    return gridPassed;
+}
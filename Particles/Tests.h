@@ -0,0 +1,51 @@
+#pragma once
+#include "Particle.h"
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// Unit tests of the engine's modules, run by the particles_tests executable
+// (make test). Particle and the Matrices keep theirs in Particle::unitTests.
+// Each returns whether it passed, and may print what went wrong when not.
+
+inline bool almostEqual(double a, double b, double eps = 0.0001)
+{
+    return fabs(a - b) < eps;
+}
+
+// RandomTests.cpp
+bool testRandomStreams();
+
+// VertexKernelsTests.cpp
+bool testVertexKernels();
+
+// PrecisionTests.cpp
+bool testFloatPrecision();
+
+// ShapeLibraryTests.cpp
+bool testShapes();
+
+// ParticleSystemTests.cpp
+bool testPooledSpawning();
+bool testPosedShapes();
+bool testInterpolation();
+bool testCulling();
+bool testLevelOfDetail();
+bool testSaveRestore();
+bool testThreadCountDeterminism();
+
+// RecordingTests.cpp
+bool testRecordingRoundTrip();
+bool testRecordingCutShort();
+
+// SpatialGridTests.cpp
+bool testSpatialGrid();
+
+// SoftwareRasterizerTests.cpp
+bool testSoftwareRasterizer();
+
+// InputSourceTests.cpp
+bool testInput();
+
+// FrameBudgetTests.cpp
+bool testFrameBudget();
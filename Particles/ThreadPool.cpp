@@ -0,0 +1,158 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : m_generation(0), m_stop(false), m_body(nullptr), m_remaining(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        m_queues.push_back(unique_ptr<Queue>(new Queue()));
+    }
+    for (unsigned i = 1; i < threadCount; i++)
+    {
+        m_workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        m_workers[i].join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)>& body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+
+    // A single chunk or a single thread: no need to involve the workers
+    if (chunks == 1 || m_workers.empty())
+    {
+        for (size_t begin = 0; begin < count; begin += grain)
+        {
+            body(begin, min(count, begin + grain));
+        }
+        return;
+    }
+
+    // Publish the body before any chunk becomes visible: a worker still looking
+    // for work from the previous call may pick up a chunk as soon as it is queued
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_body = &body;
+        m_remaining.store(chunks);
+    }
+
+    // Deal the chunks out in contiguous blocks so each thread starts on
+    // neighbouring particles; stealing evens out the rest
+    const size_t threads = m_queues.size();
+    for (size_t t = 0; t < threads; t++)
+    {
+        const size_t first = chunks * t / threads;
+        const size_t last = chunks * (t + 1) / threads;
+        lock_guard<mutex> guard(m_queues[t]->lock);
+        m_queues[t]->chunks.clear();
+        m_queues[t]->head = 0;
+        for (size_t c = first; c < last; c++)
+        {
+            Chunk chunk = { c * grain, min(count, (c + 1) * grain) };
+            m_queues[t]->chunks.push_back(chunk);
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    while (runOne(0))
+    {
+    }
+
+    unique_lock<mutex> lock(m_lock);
+    m_done.wait(lock, [this]() { return m_remaining.load() == 0; });
+    m_body = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned self)
+{
+    unsigned long seen = 0;
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(m_lock);
+            m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+            if (m_stop)
+            {
+                return;
+            }
+            seen = m_generation;
+        }
+
+        while (runOne(self))
+        {
+        }
+    }
+}
+
+bool ThreadPool::runOne(unsigned self)
+{
+    Chunk chunk;
+    bool found = false;
+
+    // Own queue first, newest chunk
+    {
+        Queue& own = *m_queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (own.head < own.chunks.size())
+        {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            found = true;
+        }
+    }
+
+    // Then steal the oldest chunk from another thread
+    for (size_t k = 1; !found && k < m_queues.size(); k++)
+    {
+        Queue& victim = *m_queues[(self + k) % m_queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (victim.head < victim.chunks.size())
+        {
+            chunk = victim.chunks[victim.head++];
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    (*m_body)(chunk.begin, chunk.end);
+
+    if (m_remaining.fetch_sub(1) == 1)
+    {
+        // Take the lock so the notify cannot slip in between the caller's
+        // check and its wait
+        lock_guard<mutex> guard(m_lock);
+        m_done.notify_all();
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Persistent pool of worker threads with per-thread work-stealing queues.
+// parallelFor splits a range into chunks and deals them out in contiguous
+// blocks, one block per thread. Each thread takes work from the back of its own
+// queue and steals from the front of the others' queues when it runs dry.
+// The calling thread works too, so a pool of N threads starts N - 1 workers.
+class ThreadPool
+{
+public:
+    // threadCount 0 means one thread per hardware core
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned getThreadCount() const { return static_cast<unsigned>(m_queues.size()); }
+
+    // Call body(begin, end) for consecutive chunks of [0, count), each at most
+    // grain items long, and return once all of them have finished.
+    // body must not throw. Only one parallelFor may run at a time.
+    void parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)>& body);
+
+private:
+    struct Chunk
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    // Chunks [head, size) are still to run. The owner takes from the back and
+    // thieves from the head; the vector is only refilled once it is drained, so
+    // it keeps its capacity and steady-state calls do not allocate.
+    struct Queue
+    {
+        mutex lock;
+        vector<Chunk> chunks;
+        size_t head = 0;
+    };
+
+    vector<unique_ptr<Queue>> m_queues;       // One per thread, the caller's is 0
+    vector<thread> m_workers;
+
+    mutex m_lock;                             // Guards the fields below
+    condition_variable m_wake;                // Signals a new parallelFor or shutdown
+    condition_variable m_done;                // Signals the last chunk finished
+    unsigned long m_generation;               // Bumped by every parallelFor
+    bool m_stop;
+
+    const function<void(size_t, size_t)>* m_body; // Body of the running parallelFor
+    atomic<size_t> m_remaining;               // Chunks not finished yet
+
+    void workerLoop(unsigned self);
+
+    // Run one chunk from our own queue or stolen from another.
+    // Returns false once every queue is empty.
+    bool runOne(unsigned self);
+};
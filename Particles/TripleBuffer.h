@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread without
+// either ever waiting. The writer fills back() and publishes it; the reader
+// acquires the newest published value into front(). Values published while
+// the reader was not looking are skipped, so the reader always sees the
+// latest one. Each side owns its slot exclusively until it swaps it away.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+        : m_back(0), m_middle(1), m_front(2)
+    {
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side
+    T& back() { return m_slots[m_back]; }
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader side: take the newest published value, if there is one since the
+    // last call. Returns false and keeps the current front otherwise.
+    bool acquire()
+    {
+        if (!(m_middle.load(std::memory_order_acquire) & kFresh))
+        {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    T& front() { return m_slots[m_front]; }
+
+private:
+    static const int kIndex = 3; // Slot index bits of m_middle
+    static const int kFresh = 4; // Set when m_middle holds a value the reader has not taken
+
+    T m_slots[3];
+    int m_back;                  // Writer's slot
+    std::atomic<int> m_middle;   // Slot in transit, plus kFresh
+    int m_front;                 // Reader's slot
+};
@@ -0,0 +1,250 @@
+#include "VertexKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VERTEX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+using Matrices::AffineTransform;
+using Matrices::AffineTransformF;
+
+namespace VertexKernels
+{
+    namespace
+    {
+        typedef void (*Kernel)(const AffineTransform& t, double* x, double* y, int n);
+        typedef void (*KernelF)(const AffineTransformF& t, float* x, float* y, int n);
+
+        template <typename T>
+        void transformScalar(const Matrices::BasicAffineTransform<T>& t, T* x, T* y, int n)
+        {
+            t.apply(x, y, n);
+        }
+
+        // Finish the last few points that do not fill a whole register
+        template <typename T>
+        inline void transformTail(const Matrices::BasicAffineTransform<T>& t, T* x, T* y, int j, int n)
+        {
+            t.apply(x + j, y + j, n - j);
+        }
+
+#ifdef VERTEX_KERNELS_X86
+        __attribute__((target("sse2")))
+        void transformSSE2(const AffineTransform& t, double* x, double* y, int n)
+        {
+            const __m128d m00 = _mm_set1_pd(t.m00), m01 = _mm_set1_pd(t.m01), m02 = _mm_set1_pd(t.m02);
+            const __m128d m10 = _mm_set1_pd(t.m10), m11 = _mm_set1_pd(t.m11), m12 = _mm_set1_pd(t.m12);
+            int j = 0;
+            for (; j + 2 <= n; j += 2)
+            {
+                const __m128d px = _mm_loadu_pd(x + j);
+                const __m128d py = _mm_loadu_pd(y + j);
+                _mm_storeu_pd(x + j, _mm_add_pd(_mm_add_pd(_mm_mul_pd(m00, px), _mm_mul_pd(m01, py)), m02));
+                _mm_storeu_pd(y + j, _mm_add_pd(_mm_add_pd(_mm_mul_pd(m10, px), _mm_mul_pd(m11, py)), m12));
+            }
+            transformTail(t, x, y, j, n);
+        }
+
+        __attribute__((target("avx2")))
+        void transformAVX2(const AffineTransform& t, double* x, double* y, int n)
+        {
+            const __m256d m00 = _mm256_set1_pd(t.m00), m01 = _mm256_set1_pd(t.m01), m02 = _mm256_set1_pd(t.m02);
+            const __m256d m10 = _mm256_set1_pd(t.m10), m11 = _mm256_set1_pd(t.m11), m12 = _mm256_set1_pd(t.m12);
+            int j = 0;
+            for (; j + 4 <= n; j += 4)
+            {
+                const __m256d px = _mm256_loadu_pd(x + j);
+                const __m256d py = _mm256_loadu_pd(y + j);
+                _mm256_storeu_pd(x + j, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m00, px), _mm256_mul_pd(m01, py)), m02));
+                _mm256_storeu_pd(y + j, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m10, px), _mm256_mul_pd(m11, py)), m12));
+            }
+            transformTail(t, x, y, j, n);
+        }
+
+        __attribute__((target("avx512f")))
+        void transformAVX512(const AffineTransform& t, double* x, double* y, int n)
+        {
+            const __m512d m00 = _mm512_set1_pd(t.m00), m01 = _mm512_set1_pd(t.m01), m02 = _mm512_set1_pd(t.m02);
+            const __m512d m10 = _mm512_set1_pd(t.m10), m11 = _mm512_set1_pd(t.m11), m12 = _mm512_set1_pd(t.m12);
+            int j = 0;
+            for (; j < n; j += 8)
+            {
+                // Masked loads and stores handle the last partial register too
+                const __mmask8 mask = n - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - j)) - 1);
+                const __m512d px = _mm512_maskz_loadu_pd(mask, x + j);
+                const __m512d py = _mm512_maskz_loadu_pd(mask, y + j);
+                _mm512_mask_storeu_pd(x + j, mask, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m00, px), _mm512_mul_pd(m01, py)), m02));
+                _mm512_mask_storeu_pd(y + j, mask, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m10, px), _mm512_mul_pd(m11, py)), m12));
+            }
+        }
+
+        // The same kernels in float, with twice the points per register
+        __attribute__((target("sse2")))
+        void transformSSE2(const AffineTransformF& t, float* x, float* y, int n)
+        {
+            const __m128 m00 = _mm_set1_ps(t.m00), m01 = _mm_set1_ps(t.m01), m02 = _mm_set1_ps(t.m02);
+            const __m128 m10 = _mm_set1_ps(t.m10), m11 = _mm_set1_ps(t.m11), m12 = _mm_set1_ps(t.m12);
+            int j = 0;
+            for (; j + 4 <= n; j += 4)
+            {
+                const __m128 px = _mm_loadu_ps(x + j);
+                const __m128 py = _mm_loadu_ps(y + j);
+                _mm_storeu_ps(x + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)), m02));
+                _mm_storeu_ps(y + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)), m12));
+            }
+            transformTail(t, x, y, j, n);
+        }
+
+        __attribute__((target("avx2")))
+        void transformAVX2(const AffineTransformF& t, float* x, float* y, int n)
+        {
+            const __m256 m00 = _mm256_set1_ps(t.m00), m01 = _mm256_set1_ps(t.m01), m02 = _mm256_set1_ps(t.m02);
+            const __m256 m10 = _mm256_set1_ps(t.m10), m11 = _mm256_set1_ps(t.m11), m12 = _mm256_set1_ps(t.m12);
+            int j = 0;
+            for (; j + 8 <= n; j += 8)
+            {
+                const __m256 px = _mm256_loadu_ps(x + j);
+                const __m256 py = _mm256_loadu_ps(y + j);
+                _mm256_storeu_ps(x + j, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, px), _mm256_mul_ps(m01, py)), m02));
+                _mm256_storeu_ps(y + j, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, px), _mm256_mul_ps(m11, py)), m12));
+            }
+            transformTail(t, x, y, j, n);
+        }
+
+        __attribute__((target("avx512f")))
+        void transformAVX512(const AffineTransformF& t, float* x, float* y, int n)
+        {
+            const __m512 m00 = _mm512_set1_ps(t.m00), m01 = _mm512_set1_ps(t.m01), m02 = _mm512_set1_ps(t.m02);
+            const __m512 m10 = _mm512_set1_ps(t.m10), m11 = _mm512_set1_ps(t.m11), m12 = _mm512_set1_ps(t.m12);
+            int j = 0;
+            for (; j < n; j += 16)
+            {
+                const __mmask16 mask = n - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (n - j)) - 1);
+                const __m512 px = _mm512_maskz_loadu_ps(mask, x + j);
+                const __m512 py = _mm512_maskz_loadu_ps(mask, y + j);
+                _mm512_mask_storeu_ps(x + j, mask, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m00, px), _mm512_mul_ps(m01, py)), m02));
+                _mm512_mask_storeu_ps(y + j, mask, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m10, px), _mm512_mul_ps(m11, py)), m12));
+            }
+        }
+#endif
+
+        Kernel kernelFor(Isa isa)
+        {
+            switch (isa)
+            {
+#ifdef VERTEX_KERNELS_X86
+                case AVX512: return transformAVX512;
+                case AVX2: return transformAVX2;
+                case SSE2: return transformSSE2;
+#endif
+                default: return transformScalar<double>;
+            }
+        }
+
+        KernelF kernelForF(Isa isa)
+        {
+            switch (isa)
+            {
+#ifdef VERTEX_KERNELS_X86
+                case AVX512: return transformAVX512;
+                case AVX2: return transformAVX2;
+                case SSE2: return transformSSE2;
+#endif
+                default: return transformScalar<float>;
+            }
+        }
+
+        Isa widestSupported(Isa limit)
+        {
+            int isa = limit;
+            while (isa > Scalar && !isSupported(static_cast<Isa>(isa)))
+            {
+                isa--;
+            }
+            return static_cast<Isa>(isa);
+        }
+
+        // Current dispatch target, chosen on first use
+        struct Dispatch
+        {
+            Isa isa;
+            Kernel kernel;
+            KernelF kernelF;
+            Dispatch() : isa(widestSupported(AVX512)), kernel(kernelFor(isa)), kernelF(kernelForF(isa)) {}
+        };
+
+        Dispatch& dispatch()
+        {
+            static Dispatch d;
+            return d;
+        }
+    }
+
+    const char* isaName(Isa isa)
+    {
+        switch (isa)
+        {
+            case AVX512: return "avx512";
+            case AVX2: return "avx2";
+            case SSE2: return "sse2";
+            default: return "scalar";
+        }
+    }
+
+    bool isSupported(Isa isa)
+    {
+        switch (isa)
+        {
+            case Scalar: return true;
+#ifdef VERTEX_KERNELS_X86
+            case SSE2: return __builtin_cpu_supports("sse2");
+            case AVX2: return __builtin_cpu_supports("avx2");
+            case AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+            default: return false;
+        }
+    }
+
+    Isa activeIsa()
+    {
+        return dispatch().isa;
+    }
+
+    void setIsa(Isa isa)
+    {
+        Dispatch& d = dispatch();
+        d.isa = widestSupported(isa);
+        d.kernel = kernelFor(d.isa);
+        d.kernelF = kernelForF(d.isa);
+    }
+
+    void transform(const AffineTransform& t, double* x, double* y, int n)
+    {
+        dispatch().kernel(t, x, y, n);
+    }
+
+    void transform(const AffineTransformF& t, float* x, float* y, int n)
+    {
+        dispatch().kernelF(t, x, y, n);
+    }
+
+    void transformBatch(const AffineTransform* transforms, const int* offsets, const int* counts,
+                        size_t count, double* x, double* y)
+    {
+        const Kernel kernel = dispatch().kernel;
+        for (size_t k = 0; k < count; k++)
+        {
+            kernel(transforms[k], x + offsets[k], y + offsets[k], counts[k]);
+        }
+    }
+
+    void transformBatch(const AffineTransformF* transforms, const int* offsets, const int* counts,
+                        size_t count, float* x, float* y)
+    {
+        const KernelF kernel = dispatch().kernelF;
+        for (size_t k = 0; k < count; k++)
+        {
+            kernel(transforms[k], x + offsets[k], y + offsets[k], counts[k]);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include "Matrices.h"
+
+// Vectorized affine transforms over particle vertices.
+// Vertices are stored as separate x and y arrays (the two rows of a 2xn Matrix),
+// so one SIMD register holds consecutive x (or y) coordinates: twice as many
+// of them in float as in double.
+// The best instruction set is picked once at runtime from what the CPU supports.
+// Every kernel performs the same multiplies and adds in the same order as
+// AffineTransform::apply, so they agree exactly unless the build allows the
+// compiler to contract them into fused multiply-adds.
+namespace VertexKernels
+{
+    enum Isa
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    // Human-readable name, e.g. "avx2"
+    const char* isaName(Isa isa);
+
+    // True if this CPU (and build) can run the kernel for isa
+    bool isSupported(Isa isa);
+
+    // The instruction set the kernels currently dispatch to.
+    // Defaults to the widest supported one.
+    Isa activeIsa();
+
+    // Force the kernels to a given instruction set, e.g. for tests or benchmarks.
+    // Falls back to the widest supported set narrower than isa.
+    void setIsa(Isa isa);
+
+    // Transform n points in place.
+    void transform(const Matrices::AffineTransform& t, double* x, double* y, int n);
+    void transform(const Matrices::AffineTransformF& t, float* x, float* y, int n);
+
+    // Transform count vertex ranges of one shared buffer in one call.
+    // Range k covers x[offsets[k]] .. x[offsets[k] + counts[k] - 1] and is
+    // transformed by transforms[k].
+    void transformBatch(const Matrices::AffineTransform* transforms, const int* offsets, const int* counts,
+                        size_t count, double* x, double* y);
+    void transformBatch(const Matrices::AffineTransformF* transforms, const int* offsets, const int* counts,
+                        size_t count, float* x, float* y);
+}
@@ -0,0 +1,46 @@
+#include "Tests.h"
+#include "VertexKernels.h"
+
+bool testVertexKernels()
+{
+    Matrix shape(2, 37); // Odd size so every kernel also runs its tail
+    for (int j = 0; j < shape.getCols(); ++j)
+    {
+        shape(0, j) = 400.0 * cos(j * 0.17) - 120.0;
+        shape(1, j) = 250.0 * sin(j * 0.31) + 75.0;
+    }
+    double kernelCx = -120.0, kernelCy = 75.0, kernelDx = 3.5, kernelDy = -8.25;
+    Matrix kernelExpected = shape;
+    for (int j = 0; j < kernelExpected.getCols(); ++j)
+    {
+        kernelExpected(0, j) -= kernelCx;
+        kernelExpected(1, j) -= kernelCy;
+    }
+    kernelExpected = ScalingMatrix(SCALE) * (RotationMatrix(0.05) * kernelExpected);
+    kernelExpected += TranslationMatrix(kernelCx + kernelDx, kernelCy + kernelDy, kernelExpected.getCols());
+    AffineTransform kernelTransform = AffineTransform::aboutCenter(0.05, SCALE, kernelCx, kernelCy, kernelDx, kernelDy);
+    VertexKernels::Isa defaultIsa = VertexKernels::activeIsa();
+    bool kernelsPassed = true;
+    for (int isa = VertexKernels::Scalar; isa <= VertexKernels::AVX512; ++isa)
+    {
+        if (!VertexKernels::isSupported(static_cast<VertexKernels::Isa>(isa)))
+        {
+            continue;
+        }
+        VertexKernels::setIsa(static_cast<VertexKernels::Isa>(isa));
+        Matrix kernelResult = shape;
+        VertexKernels::transform(kernelTransform, kernelResult.row(0), kernelResult.row(1), kernelResult.getCols());
+        for (int j = 0; j < shape.getCols(); ++j)
+        {
+            if (!almostEqual(kernelResult(0, j), kernelExpected(0, j)) || !almostEqual(kernelResult(1, j), kernelExpected(1, j)))
+            {
+                cout << "Failed for " << VertexKernels::isaName(VertexKernels::activeIsa()) << " at point " << j << endl;
+                kernelsPassed = false;
+                break;
+            }
+        }
+    }
+    VertexKernels::setIsa(defaultIsa);
+
+    return kernelsPassed;
+}
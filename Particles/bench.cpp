@@ -0,0 +1,1105 @@
+#include "Benchmark.h"
+#include "Engine.h"
+#include "InputSource.h"
+#include "Matrices.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Recording.h"
+#include "Replay.h"
+#include "SoftwareRasterizer.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include "VertexKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+using namespace Matrices;
+
+namespace
+{
+    const float kDt = 1.0f / 60.0f;
+    const double kSpin = 1.3;
+    const int kParticles = 1000;
+
+    // A batch of particle shapes the size Engine::input produces (25 to 50 vertices)
+    vector<Matrix> makeShapes(int count)
+    {
+        vector<Matrix> shapes;
+        Random random(1);
+        for (int i = 0; i < count; i++)
+        {
+            int numPoints = random.uniformInt(25, 50);
+            Matrix A(2, numPoints);
+            for (int j = 0; j < numPoints; j++)
+            {
+                A(0, j) = random.uniformInt(-500, 499);
+                A(1, j) = random.uniformInt(-500, 499);
+            }
+            shapes.push_back(A);
+        }
+        return shapes;
+    }
+
+    // The per-frame transform Particle::update used before it was fused:
+    // rotate, scale and translate, each about the center with Matrix temporaries
+    void threePassUpdate(Matrix& A, double cx, double cy, double dx, double dy)
+    {
+        for (int j = 0; j < A.getCols(); ++j) { A(0, j) -= cx; A(1, j) -= cy; }
+        RotationMatrix R(kDt * kSpin);
+        A = R * A;
+        for (int j = 0; j < A.getCols(); ++j) { A(0, j) += cx; A(1, j) += cy; }
+
+        for (int j = 0; j < A.getCols(); ++j) { A(0, j) -= cx; A(1, j) -= cy; }
+        ScalingMatrix S(0.999);
+        A = S * A;
+        for (int j = 0; j < A.getCols(); ++j) { A(0, j) += cx; A(1, j) += cy; }
+
+        TranslationMatrix T(dx, dy, A.getCols());
+        A = T + A;
+    }
+
+    void fusedUpdate(Matrix& A, double cx, double cy, double dx, double dy)
+    {
+        AffineTransform T = AffineTransform::aboutCenter(kDt * kSpin, 0.999, cx, cy, dx, dy);
+        T.apply(A);
+    }
+
+    void report(const string& name, double nsPerFrame, size_t vertices)
+    {
+        cout << left << setw(28) << name << right << fixed << setprecision(1)
+             << setw(12) << nsPerFrame / kParticles << " ns/particle"
+             << setw(10) << nsPerFrame / vertices << " ns/vertex" << endl;
+    }
+
+    void benchTransform()
+    {
+        vector<Matrix> shapes = makeShapes(kParticles);
+        size_t vertices = 0;
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            vertices += shapes[i].getCols();
+        }
+
+        cout << "transform: " << kParticles << " particles, " << vertices << " vertices per frame" << endl;
+        double threePass = Benchmark::nsPerCall([&]() {
+            for (size_t i = 0; i < shapes.size(); i++)
+            {
+                threePassUpdate(shapes[i], 1.0, -2.0, 0.5, 0.25);
+            }
+            Benchmark::doNotOptimize(shapes[0](0, 0));
+        });
+        double fused = Benchmark::nsPerCall([&]() {
+            for (size_t i = 0; i < shapes.size(); i++)
+            {
+                fusedUpdate(shapes[i], 1.0, -2.0, 0.5, 0.25);
+            }
+            Benchmark::doNotOptimize(shapes[0](0, 0));
+        });
+        report("rotate+scale+translate", threePass, vertices);
+        report("fused affine", fused, vertices);
+        cout << "speedup: " << setprecision(2) << threePass / fused << "x" << endl;
+    }
+
+    // Vertices per second through transformBatch for every supported
+    // instruction set, in double and in float
+    void benchKernels()
+    {
+        const int particles = 10000;
+        vector<int> offsets, counts;
+        vector<AffineTransform> transforms;
+        vector<AffineTransformF> transformsF;
+        Random random(1);
+        int vertices = 0;
+        for (int i = 0; i < particles; i++)
+        {
+            int numPoints = random.uniformInt(25, 50);
+            offsets.push_back(vertices);
+            counts.push_back(numPoints);
+            transforms.push_back(AffineTransform::aboutCenter(kDt * kSpin, 0.999, i % 100, i % 37, 0.5, -0.25));
+            transformsF.push_back(AffineTransformF::aboutCenter(kDt * kSpin, 0.999, i % 100, i % 37, 0.5, -0.25));
+            vertices += numPoints;
+        }
+        vector<double> x(vertices), y(vertices);
+        for (int j = 0; j < vertices; j++)
+        {
+            x[j] = random.uniformInt(-500, 499);
+            y[j] = random.uniformInt(-500, 499);
+        }
+        vector<float> xF(x.begin(), x.end()), yF(y.begin(), y.end());
+
+        cout << "kernels: " << particles << " particles, " << vertices << " vertices per batch" << endl;
+        VertexKernels::Isa defaultIsa = VertexKernels::activeIsa();
+        for (int isa = VertexKernels::Scalar; isa <= VertexKernels::AVX512; isa++)
+        {
+            if (!VertexKernels::isSupported(static_cast<VertexKernels::Isa>(isa)))
+            {
+                cout << left << setw(10) << VertexKernels::isaName(static_cast<VertexKernels::Isa>(isa)) << "unsupported" << endl;
+                continue;
+            }
+            VertexKernels::setIsa(static_cast<VertexKernels::Isa>(isa));
+            double ns = Benchmark::nsPerCall([&]() {
+                VertexKernels::transformBatch(transforms.data(), offsets.data(), counts.data(), particles, x.data(), y.data());
+                Benchmark::doNotOptimize(x[0]);
+            });
+            double nsF = Benchmark::nsPerCall([&]() {
+                VertexKernels::transformBatch(transformsF.data(), offsets.data(), counts.data(), particles, xF.data(), yF.data());
+                Benchmark::doNotOptimize(xF[0]);
+            });
+            cout << left << setw(10) << VertexKernels::isaName(static_cast<VertexKernels::Isa>(isa)) << right << fixed
+                 << setprecision(1) << setw(10) << vertices / ns * 1e3 << " Mvertices/s double" << setw(10)
+                 << vertices / nsF * 1e3 << " Mvertices/s float" << endl;
+        }
+        VertexKernels::setIsa(defaultIsa);
+    }
+
+    // ParticleSystem::update throughput from 1 thread up to one per core.
+    // The checksum column shows the simulated state is the same for every thread count.
+    void benchThreads()
+    {
+        const int particles = 100000;
+        const int frames = 60;
+        ParticleSystem initial;
+        initial.reserve(particles, particles * 50);
+        Random random(1);
+        for (int i = 0; i < particles; i++)
+        {
+            Vector2i position(random.uniformInt(0, 1919), random.uniformInt(0, 1079));
+            initial.add(Particle(Vector2u(1920, 1080), random.uniformInt(25, 50), position, random));
+        }
+
+        unsigned maxThreads = max(1u, thread::hardware_concurrency());
+        vector<unsigned> threadCounts;
+        for (unsigned t = 1; t < maxThreads; t *= 2)
+        {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(maxThreads);
+
+        cout << "threads: " << particles << " particles, " << initial.vertexCount() << " vertices, "
+             << frames << " frames" << endl;
+        double serialMs = 0.0;
+        for (size_t k = 0; k < threadCounts.size(); k++)
+        {
+            ThreadPool pool(threadCounts[k]);
+            ParticleSystem system = initial;
+            Benchmark::Clock::time_point start = Benchmark::Clock::now();
+            for (int f = 0; f < frames; f++)
+            {
+                system.update(kDt, &pool);
+            }
+            double ms = Benchmark::secondsSince(start) * 1e3 / frames;
+            if (k == 0)
+            {
+                serialMs = ms;
+            }
+            cout << setw(3) << threadCounts[k] << " threads" << fixed << setprecision(2)
+                 << setw(10) << ms << " ms/frame" << setw(10) << particles / ms / 1e3 << " Mparticles/s"
+                 << setw(8) << serialMs / ms << "x" << "   checksum " << hex << system.checksum() << dec << endl;
+        }
+    }
+
+    // Update time per frame while a burst of 10k particles expires all at once,
+    // on top of a steady stream of 5 spawns per frame
+    void benchExpiry()
+    {
+        const int burst = 10000;
+        const int frames = 240;
+        ParticleSystem system;
+        Random random(1);
+        for (int i = 0; i < burst; i++)
+        {
+            system.add(Particle(Vector2u(1920, 1080), random.uniformInt(25, 50), Vector2i(960, 540), random));
+        }
+
+        vector<double> frameMs;
+        size_t expiryFrame = 0;
+        for (int f = 0; f < frames; f++)
+        {
+            for (int k = 0; k < 5; k++)
+            {
+                system.add(Particle(Vector2u(1920, 1080), random.uniformInt(25, 50), Vector2i(960, 540), random));
+            }
+            const size_t before = system.size();
+            Benchmark::Clock::time_point start = Benchmark::Clock::now();
+            system.update(kDt);
+            frameMs.push_back(Benchmark::secondsSince(start) * 1e3);
+            if (before >= burst && system.size() + burst / 2 < before)
+            {
+                expiryFrame = f;
+            }
+        }
+
+        double expiryMs = frameMs[expiryFrame];
+        sort(frameMs.begin(), frameMs.end());
+        cout << "expiry: " << burst << " particles expiring together, 5 spawned per frame" << endl;
+        cout << fixed << setprecision(3) << "median frame " << frameMs[frameMs.size() / 2] << " ms, "
+             << "expiry frame " << expiryMs << " ms, max " << frameMs.back() << " ms" << endl;
+    }
+
+    // Spatial grid: build and query cost as the particle count grows at a
+    // constant density, which should stay flat per particle, then collisions
+    void benchGrid()
+    {
+        // About four particles per 160-unit cell, as in a busy scene
+        auto scatter = [](size_t count, Random& random) {
+            const float side = 80.0f * sqrt(static_cast<float>(count));
+            vector<Vector2f> points(count);
+            for (Vector2f& p : points)
+            {
+                p = Vector2f(static_cast<float>(random.uniform(0.0, side)), static_cast<float>(random.uniform(0.0, side)));
+            }
+            return points;
+        };
+
+        cout << "grid: build and 160-unit neighbor queries at constant density" << endl;
+        Random random(1);
+        SpatialGrid grid;
+        for (size_t count = 12500; count <= 200000; count *= 2)
+        {
+            vector<Vector2f> points = scatter(count, random);
+            double build = Benchmark::nsPerCall([&]() { grid.build(points.data(), count); }) / count;
+            size_t found = 0;
+            // Queried in grid order, as the collision pass does
+            double query = Benchmark::nsPerCall([&]() {
+                found = 0;
+                for (size_t k = 0; k < count; k++)
+                {
+                    grid.forEachWithin(points[grid.item(k)], 160.0f, [&found](uint32_t) { found++; });
+                }
+            }) / count;
+            cout << setw(8) << count << fixed << setprecision(2) << setw(10) << build << " ns/point build"
+                 << setw(10) << query << " ns/point query" << setw(8) << setprecision(1)
+                 << static_cast<double>(found) / count << " neighbors" << endl;
+        }
+
+        // The same overlap test all-pairs and through the grid
+        const size_t pairsCount = 2000;
+        vector<Vector2f> points = scatter(pairsCount, random);
+        size_t naivePairs = 0, gridPairs = 0;
+        double naive = Benchmark::nsPerCall([&]() {
+            naivePairs = 0;
+            for (size_t i = 0; i < pairsCount; i++)
+            {
+                for (size_t j = 0; j < pairsCount; j++)
+                {
+                    const Vector2f d = points[j] - points[i];
+                    naivePairs += j != i && d.x * d.x + d.y * d.y <= 160.0f * 160.0f;
+                }
+            }
+        });
+        double indexed = Benchmark::nsPerCall([&]() {
+            gridPairs = 0;
+            grid.build(points.data(), pairsCount);
+            for (size_t i = 0; i < pairsCount; i++)
+            {
+                grid.forEachWithin(points[i], 160.0f, [&gridPairs, i](uint32_t j) { gridPairs += j != i; });
+            }
+        });
+        cout << setw(8) << pairsCount << setprecision(2) << setw(10) << naive / 1e3 << " us all-pairs"
+             << setw(10) << indexed / 1e3 << " us grid" << setw(10) << naive / indexed << "x"
+             << (naivePairs == gridPairs ? "   same pairs" : "   DIFFERENT PAIRS") << endl;
+
+        // Whole updates with collisions on, serial and on every core
+        unsigned maxThreads = max(1u, thread::hardware_concurrency());
+        for (size_t count = 12500; count <= 100000; count *= 2)
+        {
+            const unsigned side = static_cast<unsigned>(80.0f * sqrt(static_cast<float>(count)));
+            ParticleSystem initial;
+            CollisionConfig collisions;
+            collisions.enabled = true;
+            initial.setCollisions(collisions);
+            EmitterConfig emitter;
+            for (size_t i = 0; i < count; i++)
+            {
+                Vector2i position(random.uniformInt(0, side - 1), random.uniformInt(0, side - 1));
+                initial.spawn(Vector2u(side, side), emitter, position, random);
+            }
+            double ms[2];
+            unsigned long long sums[2];
+            for (int threaded = 0; threaded < 2; threaded++)
+            {
+                ThreadPool pool(threaded ? maxThreads : 1);
+                ParticleSystem system = initial;
+                Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                for (int f = 0; f < 10; f++)
+                {
+                    system.update(kDt, threaded ? &pool : nullptr);
+                }
+                ms[threaded] = Benchmark::secondsSince(start) * 1e3 / 10;
+                sums[threaded] = system.checksum();
+            }
+            cout << setw(8) << count << setprecision(2) << setw(10) << ms[0] * 1e6 / count << " ns/particle update, collisions"
+                 << setw(10) << ms[1] * 1e6 / count << " on " << maxThreads << " threads"
+                 << (sums[0] == sums[1] ? "   same checksum" : "   DIFFERENT CHECKSUM") << endl;
+        }
+    }
+
+    // The burst scenario drawn three ways: every particle, culled to the
+    // screen, and culled with off-screen retirement. The last two must build
+    // exactly the same vertices every frame.
+    void benchCulling()
+    {
+        const Vector2u screen(1920, 1080);
+        ParticleSystem systems[3];
+        systems[1].setViewport(cartesianViewport(screen));
+        systems[2].setViewport(cartesianViewport(screen));
+        systems[2].setRetireOffscreen(true);
+        const char* labels[] = { "no culling", "culling", "culling, retiring" };
+
+        Random randoms[3] = { Random(1), Random(1), Random(1) };
+        EmitterConfig emitter;
+        double updateMs[3] = { 0.0, 0.0, 0.0 };
+        double buildMs[3] = { 0.0, 0.0, 0.0 };
+        double live[3] = { 0.0, 0.0, 0.0 };
+        size_t culled = 0;
+        bool identical = true;
+        vector<Vertex> culledStream;
+        const int frames = 600;
+        for (int f = 0; f < frames; f++)
+        {
+            size_t sizes[3];
+            for (int k = 0; k < 3; k++)
+            {
+                Random& random = randoms[k];
+                if (f % 30 == 0)
+                {
+                    Vector2i position(random.uniformInt(0, 1919), random.uniformInt(0, 1079));
+                    for (int n = 0; n < 2000; n++)
+                    {
+                        systems[k].spawn(screen, emitter, position, random);
+                    }
+                }
+                Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                systems[k].update(kDt);
+                updateMs[k] += Benchmark::secondsSince(start) * 1e3;
+                start = Benchmark::Clock::now();
+                sizes[k] = systems[k].buildStream();
+                buildMs[k] += Benchmark::secondsSince(start) * 1e3;
+                live[k] += systems[k].size();
+            }
+            culled += systems[1].culledCount();
+            culledStream.assign(systems[1].getStream(), systems[1].getStream() + sizes[1]);
+            identical = identical && sizes[1] == sizes[2];
+            for (size_t v = 0; v < sizes[1] && identical; v++)
+            {
+                identical = culledStream[v].position == systems[2].getStream()[v].position;
+            }
+        }
+
+        cout << "culling: bursts of 2000 every 30 frames, " << frames << " frames" << endl << fixed << setprecision(3);
+        for (int k = 0; k < 3; k++)
+        {
+            cout << left << setw(24) << labels[k] << right << setw(10) << updateMs[k] / frames << " ms update"
+                 << setw(10) << buildMs[k] / frames << " ms build"
+                 << setw(10) << setprecision(0) << live[k] / frames << " live" << setprecision(3) << endl;
+        }
+        cout << setprecision(0) << culled / static_cast<double>(frames) << " culled per frame without retiring; "
+             << (identical ? "retiring draws identical frames" : "RETIRING CHANGED THE FRAMES") << endl;
+    }
+
+    // Level of detail: vertices drawn and build time of the burst scene at a
+    // few edge lengths, at the engine's scale and zoomed out 4x
+    void benchLod()
+    {
+        const Vector2u screen(1920, 1080);
+        const float thresholds[] = { 0.0f, 4.0f, 8.0f, 16.0f };
+        const float zooms[] = { 1.0f, 0.25f };
+        cout << "lod: bursts of 2000 every 30 frames, culled to the screen" << endl;
+        for (float zoom : zooms)
+        {
+            for (float pixels : thresholds)
+            {
+                ParticleSystem system;
+                system.setViewport(cartesianViewport(screen));
+                system.setRetireOffscreen(true);
+                LodConfig lod;
+                lod.enabled = pixels > 0.0f;
+                lod.pixelsPerEdge = pixels;
+                lod.pixelsPerUnit = zoom;
+                system.setLod(lod);
+                Random random(1);
+                EmitterConfig emitter;
+                double buildMs = 0.0, drawn = 0.0, skipped = 0.0;
+                const int frames = 300;
+                for (int f = 0; f < frames; f++)
+                {
+                    if (f % 30 == 0)
+                    {
+                        Vector2i position(random.uniformInt(0, 1919), random.uniformInt(0, 1079));
+                        for (int n = 0; n < 2000; n++)
+                        {
+                            system.spawn(screen, emitter, position, random);
+                        }
+                    }
+                    system.update(kDt);
+                    Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                    system.buildStream();
+                    buildMs += Benchmark::secondsSince(start) * 1e3;
+                    drawn += system.drawnVertices();
+                    skipped += system.lodSkippedVertices();
+                }
+                string label = (zoom < 1.0f ? "zoom 1/4, " : "zoom 1, ")
+                    + (lod.enabled ? "edges >= " + to_string(static_cast<int>(pixels)) + " px" : string("off"));
+                cout << left << setw(24) << label << right << fixed << setprecision(3) << setw(10) << buildMs / frames
+                     << " ms build" << setprecision(0) << setw(10) << drawn / frames << " drawn" << setw(10) << skipped / frames
+                     << " skipped" << setprecision(1) << setw(8) << 100.0 * skipped / max(1.0, drawn + skipped) << "%" << endl;
+            }
+        }
+    }
+
+    // Cost of the random numbers behind a spawn, and of a whole spawn
+    void benchSpawn()
+    {
+        Random random(1);
+        double libc = Benchmark::nsPerCall([]() {
+            int sum = 0;
+            for (int k = 0; k < 1000; k++)
+            {
+                sum += rand() % 61 + 20;
+            }
+            Benchmark::doNotOptimize(sum);
+        });
+        double pcg = Benchmark::nsPerCall([&random]() {
+            int sum = 0;
+            for (int k = 0; k < 1000; k++)
+            {
+                sum += random.uniformInt(20, 80);
+            }
+            Benchmark::doNotOptimize(sum);
+        });
+        int radii[50];
+        double batch = Benchmark::nsPerCall([&random, &radii]() {
+            for (int k = 0; k < 20; k++)
+            {
+                random.fillInt(radii, 50, 20, 80);
+            }
+            Benchmark::doNotOptimize(radii[0]);
+        });
+        double particle = Benchmark::nsPerCall([&random]() {
+            Particle p(Vector2u(1920, 1080), random.uniformInt(25, 50), Vector2i(960, 540), random);
+            Benchmark::doNotOptimize(p);
+        });
+
+        cout << "spawn:" << endl << fixed << setprecision(2)
+             << left << setw(24) << "rand()" << right << setw(10) << libc / 1000 << " ns/number" << endl
+             << left << setw(24) << "Random::uniformInt" << right << setw(10) << pcg / 1000 << " ns/number" << endl
+             << left << setw(24) << "Random::fillInt" << right << setw(10) << batch / 1000 << " ns/number" << endl
+             << left << setw(24) << "Particle constructor" << right << setw(10) << particle << " ns/particle" << endl;
+
+        // Spawning into a system, once per shape source. Prebuilt shapes are
+        // referenced, so they take no vertex pool memory per particle.
+        const ShapeSource sources[] = { ShapeSource::Generated, ShapeSource::Tables, ShapeSource::Prebuilt };
+        for (ShapeSource source : sources)
+        {
+            EmitterConfig emitter;
+            emitter.shapes = source;
+            ParticleSystem system;
+            double ns = Benchmark::nsPerCall([&]() {
+                system.clear();
+                for (int k = 0; k < 1000; k++)
+                {
+                    system.spawn(Vector2u(1920, 1080), emitter, Vector2i(960, 540), random);
+                }
+            }) / 1000;
+            string label = string("spawn, ") + shapeSourceName(source);
+            cout << left << setw(24) << label << right << setw(10) << ns << " ns/particle"
+                 << setw(10) << system.vertexCapacity() * 2 * sizeof(double) / system.size() << " pool bytes/particle" << endl;
+        }
+    }
+
+    // What profiling costs: one scoped timer, and a whole headless frame with
+    // and without the profiler recording
+    void benchProfiler()
+    {
+        FrameProfiler profiler;
+        profiler.beginFrame();
+        double enabled = Benchmark::nsPerCall([&profiler]() {
+            for (int k = 0; k < 1000; k++)
+            {
+                ScopedPhase scope(&profiler, FrameProfiler::Transform);
+            }
+        }) / 1000;
+        double disabled = Benchmark::nsPerCall([]() {
+            for (int k = 0; k < 1000; k++)
+            {
+                ScopedPhase scope(nullptr, FrameProfiler::Transform);
+                Benchmark::doNotOptimize(scope);
+            }
+        }) / 1000;
+
+        // 20000 live particles, topped up every frame
+        Engine engine(Vector2u(1920, 1080));
+        auto frame = [&engine]() {
+            engine.spawn(Vector2i(960, 540), 20000 - static_cast<int>(engine.getParticleCount()));
+            engine.step(kDt);
+        };
+        for (int f = 0; f < 240; f++)
+        {
+            frame();
+        }
+
+        // Alternate a few rounds and keep the best of each, to see past noise
+        double frames[2] = { 1e300, 1e300 };
+        for (int round = 0; round < 5; round++)
+        {
+            for (int profiling = 0; profiling < 2; profiling++)
+            {
+                engine.setProfiling(profiling != 0);
+                frames[profiling] = min(frames[profiling], Benchmark::nsPerCall(frame));
+            }
+        }
+
+        cout << "profiler:" << (PARTICLES_PROFILING ? "" : " compiled out (PROFILING=0)") << endl << fixed << setprecision(2)
+             << left << setw(24) << "scope, recording" << right << setw(10) << enabled << " ns" << endl
+             << left << setw(24) << "scope, null profiler" << right << setw(10) << disabled << " ns" << endl
+             << left << setw(24) << "frame, not profiling" << right << setw(10) << frames[0] / 1000 << " us" << endl
+             << left << setw(24) << "frame, profiling" << right << setw(10) << frames[1] / 1000 << " us   ("
+             << (frames[1] - frames[0]) / 1000 << " us overhead)" << endl;
+    }
+
+    // Fixed timesteps: the same run under steady and under uneven frame
+    // times, in each mode, then a threaded simulation beside a render loop
+    void benchTimestep()
+    {
+        // Frame times in 128ths of a second, so both patterns add up to
+        // exactly the same time and a whole number of 128 Hz ticks
+        const double steady[] = { 2, 2, 2, 2 };
+        const double uneven[] = { 1, 3.5, 0.5, 3 };
+        const double tick = 1.0 / 128.0;
+        auto run = [&](Timestep mode, const double* pattern) {
+            Engine engine(Vector2u(1920, 1080));
+            engine.setTimestep(mode, 1.0 / tick);
+            engine.spawn(Vector2i(960, 540), 2000);
+            for (int f = 0; f < 128; f++)
+            {
+                engine.step(static_cast<float>(pattern[f % 4] * tick));
+            }
+            return engine.getChecksum();
+        };
+        cout << "timestep:" << endl << hex;
+        const Timestep modes[] = { Timestep::Variable, Timestep::Fixed };
+        for (Timestep mode : modes)
+        {
+            unsigned long long a = run(mode, steady);
+            unsigned long long b = run(mode, uneven);
+            cout << left << setw(24) << (mode == Timestep::Fixed ? "fixed, 128 Hz" : "variable")
+                 << "steady " << setw(18) << a << "uneven " << setw(18) << b
+                 << (a == b ? "same" : "differ") << endl;
+        }
+        cout << dec;
+
+        // Render at about 60 Hz for two seconds, with one 100 ms hitch, while
+        // the simulation ticks at 120 Hz on its own thread
+        Engine engine(Vector2u(1920, 1080));
+        engine.setTimestep(Timestep::Threaded, 120.0);
+        engine.spawn(Vector2i(960, 540), 5000);
+        vector<double> renderMs;
+        Benchmark::Clock::time_point begin = Benchmark::Clock::now();
+        Benchmark::Clock::time_point last = begin;
+        while (Benchmark::secondsSince(begin) < 2.0)
+        {
+            Benchmark::Clock::time_point now = Benchmark::Clock::now();
+            float frameSeconds = static_cast<float>(chrono::duration<double>(now - last).count());
+            last = now;
+            engine.spawn(Vector2i(960, 540), 20);
+            engine.step(frameSeconds, true);
+            renderMs.push_back(Benchmark::secondsSince(now) * 1e3);
+            this_thread::sleep_for(chrono::milliseconds(renderMs.size() == 60 ? 100 : 16));
+        }
+        double seconds = Benchmark::secondsSince(begin);
+        const Simulation& simulation = *engine.getSimulation();
+        cout << fixed << setprecision(2)
+             << left << setw(24) << "threaded, 120 Hz" << simulation.getTickCount() << " ticks in " << seconds
+             << " s, " << simulation.getDroppedTicks() << " dropped, " << renderMs.size() << " frames" << endl
+             << left << setw(24) << "render frame" << "p50 " << Benchmark::percentile(renderMs, 50)
+             << " ms, p99 " << Benchmark::percentile(renderMs, 99) << " ms, "
+             << engine.getParticleCount() << " particles" << endl;
+    }
+
+    void benchReplay()
+    {
+        // Ten seconds of uneven frames with a stream of spawns and collisions,
+        // played plain and recorded, then replayed, verified and sought into
+        const char* path = "particles_bench.rec";
+        const int frames = 600;
+        auto session = [&](bool record) {
+            Engine engine(Vector2u(1920, 1080));
+            engine.seed(3);
+            CollisionConfig collisions;
+            collisions.enabled = true;
+            engine.setCollisions(collisions);
+            if (record && !engine.startRecording(path, 60, 120))
+            {
+                cerr << "Cannot write " << path << endl;
+                exit(1);
+            }
+            vector<double> frameMs;
+            for (int f = 0; f < frames; f++)
+            {
+                Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                const double angle = f * 0.05;
+                engine.spawn(Vector2i(960 + static_cast<int>(400 * cos(angle)), 540 + static_cast<int>(300 * sin(angle))), 5);
+                engine.step(f % 3 ? 0.015f : 0.02f);
+                frameMs.push_back(Benchmark::secondsSince(start) * 1e3);
+            }
+            const unsigned long long checksum = engine.getChecksum();
+            RecordingWriter::Stats stats;
+            if (record)
+            {
+                stats = engine.getRecorder()->stats();
+            }
+            engine.stopRecording();
+            cout << left << setw(24) << (record ? "recorded" : "plain") << "frame p50 " << Benchmark::percentile(frameMs, 50)
+                 << " ms, p99 " << Benchmark::percentile(frameMs, 99) << " ms";
+            if (record)
+            {
+                cout << ", " << stats.bytes / 1024 << " KB, " << stats.handoffs << " hand-offs, at most "
+                     << stats.maxQueued << " queued" << (stats.failed ? ", WRITE FAILED" : "");
+            }
+            cout << endl;
+            return checksum;
+        };
+        cout << "replay:" << endl << fixed << setprecision(3);
+        session(false);
+        const unsigned long long recorded = session(true);
+
+        RecordingReader recording;
+        string error;
+        if (!recording.open(path, error))
+        {
+            cerr << path << ": " << error << endl;
+            exit(1);
+        }
+        Engine engine(Vector2u(1920, 1080));
+        Replay replay(recording);
+        replay.start(engine);
+        Replay::Report report = replay.play(engine, recording.frameCount(), true);
+        cout << left << setw(24) << "replayed, verified" << report.frames / report.seconds << " frames/s, "
+             << report.checks << " checks, " << report.mismatches << " mismatches, final state "
+             << (engine.getChecksum() == recorded ? "same" : "differs") << endl;
+
+        // Seeking restores the snapshot before the frame, then plays on from it
+        Benchmark::Clock::time_point start = Benchmark::Clock::now();
+        const int seeks = 20;
+        for (int k = 0; k < seeks; k++)
+        {
+            replay.seek(engine, (k * 7919) % frames + 1);
+        }
+        cout << left << setw(24) << "seek" << Benchmark::secondsSince(start) * 1e3 / seeks << " ms per seek, "
+             << recording.snapshots().size() << " snapshots" << endl;
+        remove(path);
+    }
+
+    void benchRaster()
+    {
+        // Software frames at 1080p, particles spread over the whole screen,
+        // on one thread and on all of them
+        cout << "raster:" << endl << fixed << setprecision(1);
+        const size_t counts[] = { 1000, 5000, 20000 };
+        const unsigned threadCounts[] = { 1, 0 };
+        for (size_t count : counts)
+        {
+            Engine engine(Vector2u(1920, 1080));
+            Random random(5);
+            for (size_t i = 0; i < count; i++)
+            {
+                engine.spawn(Vector2i(random.uniformInt(0, 1919), random.uniformInt(0, 1079)), 1);
+            }
+            engine.step(0.01f);
+            for (unsigned threads : threadCounts)
+            {
+                engine.setUpdateThreads(threads);
+                SoftwareRasterizer raster;
+                const double ns = Benchmark::nsPerCall([&] { engine.rasterize(raster); }, 0.5);
+                ostringstream label;
+                label << count << " particles, " << (threads ? "1 thread" : "all threads");
+                cout << left << setw(32) << label.str() << 1e9 / ns << " frames/s, " << ns * 1e-6 << " ms per frame" << endl;
+            }
+        }
+    }
+
+    // A schedule spawning far more than a frame can carry, played with no
+    // budget and under budgets of a few milliseconds: the cost of each frame's
+    // update and vertices, and the population the budget settles on
+    void benchBudget()
+    {
+        ostringstream schedule;
+        Random random(14);
+        for (int f = 0; f < 600; f++)
+        {
+            schedule << f / 60.0 << ' ' << random.uniformInt(0, 1919) << ' ' << random.uniformInt(0, 539) << " 200\n";
+        }
+        cout << "budget: 200 particles asked for every frame for 10 s" << endl << fixed << setprecision(2);
+        const double targets[] = { 0.0, 8.0, 4.0 };
+        for (double target : targets)
+        {
+            Engine engine(Vector2u(1920, 1080));
+            ScriptedInput* script = new ScriptedInput();
+            unique_ptr<InputSource> input(script);
+            istringstream in(schedule.str());
+            string error;
+            script->load(in, error);
+            engine.setInput(move(input));
+            BudgetConfig budget;
+            budget.enabled = target > 0.0;
+            budget.targetMs = target;
+            engine.setBudget(budget);
+
+            vector<double> frameMs;
+            size_t peak = 0;
+            for (int f = 0; f < 600; f++)
+            {
+                Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                engine.step(1.0f / 60.0f, true);
+                frameMs.push_back(Benchmark::secondsSince(start) * 1e3);
+                peak = max(peak, engine.getParticleCount());
+            }
+            // The last 5 s, once the budget has had time to settle
+            vector<double> settled(frameMs.begin() + 300, frameMs.end());
+            ostringstream label;
+            label << "budget " << (target > 0.0 ? to_string(static_cast<int>(target)) + " ms" : "off");
+            cout << left << setw(16) << label.str() << "p50 " << Benchmark::percentile(settled, 50) << " ms, p99 "
+                 << Benchmark::percentile(settled, 99) << " ms, peak " << peak << ", end " << engine.getParticleCount()
+                 << " particles" << endl;
+            if (budget.enabled)
+            {
+                cout << left << setw(16) << "" << engine.getBudget().summary() << endl;
+            }
+        }
+    }
+
+    void benchInput()
+    {
+        // A feed of 200000 spawn commands, a quarter with a vertex range
+        const int commands = 200000;
+        string feed;
+        Random random(9);
+        for (int k = 0; k < commands; k++)
+        {
+            ostringstream line;
+            line << random.uniformInt(0, 1919) << ' ' << random.uniformInt(0, 1079) << ' ' << random.uniformInt(1, 5);
+            if (k % 4 == 0)
+            {
+                line << ' ' << 4 << ' ' << random.uniformInt(4, 40);
+            }
+            line << '\n';
+            feed += line.str();
+        }
+        cout << "input:" << endl << fixed << setprecision(1);
+
+        // Parsing alone, the feed arriving in reads of 4 KB
+        {
+            StreamInput stream;
+            vector<SpawnCommand> out;
+            out.reserve(1024);
+            size_t parsed = 0;
+            auto parseAll = [&] {
+                for (size_t at = 0; at < feed.size(); at += 4096)
+                {
+                    out.clear();
+                    stream.feed(feed.data() + at, min<size_t>(4096, feed.size() - at), out);
+                    parsed += out.size();
+                }
+            };
+            parseAll();
+            const size_t allocationsBefore = Benchmark::allocationCount();
+            const double ns = Benchmark::nsPerCall(parseAll, 0.5);
+            const double allocations = static_cast<double>(Benchmark::allocationCount() - allocationsBefore);
+            cout << left << setw(24) << "parse" << 1e9 * commands / ns / 1e6 << " M commands/s, " << ns / commands
+                 << " ns per command, " << allocations / static_cast<double>(parsed) << " allocations per command, "
+                 << stream.stats().rejected << " rejected" << endl;
+        }
+
+        // Through a UNIX socket from a writer thread, polled once per frame
+        {
+            const char* path = "particles_bench.sock";
+            StreamInput stream;
+            string error;
+            if (!stream.listen(path, error))
+            {
+                cerr << path << ": " << error << endl;
+                exit(1);
+            }
+            thread writer([&] {
+                const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un address = sockaddr_un();
+                address.sun_family = AF_UNIX;
+                strcpy(address.sun_path, path);
+                if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+                {
+                    cerr << "Cannot connect to " << path << endl;
+                    exit(1);
+                }
+                for (size_t at = 0; at < feed.size();)
+                {
+                    const ssize_t n = send(fd, feed.data() + at, feed.size() - at, MSG_NOSIGNAL);
+                    if (n < 0)
+                    {
+                        break;
+                    }
+                    at += static_cast<size_t>(n);
+                }
+                close(fd);
+            });
+            vector<SpawnCommand> out;
+            size_t received = 0;
+            int polls = 0;
+            Benchmark::Clock::time_point start = Benchmark::Clock::now();
+            while (received < static_cast<size_t>(commands) && Benchmark::secondsSince(start) < 10.0)
+            {
+                out.clear();
+                stream.poll(kDt, out);
+                received += out.size();
+                polls++;
+            }
+            const double seconds = Benchmark::secondsSince(start);
+            stream.close();
+            writer.join();
+            cout << left << setw(24) << "socket" << received / seconds / 1e6 << " M commands/s, " << received << " of "
+                 << commands << " received in " << polls << " polls" << endl;
+        }
+
+        // A scripted schedule driving a headless engine twice: the same load,
+        // frame for frame, ends in the same state
+        {
+            ostringstream schedule;
+            for (int k = 0; k < 2000; k++)
+            {
+                schedule << k * 0.005 << ' ' << random.uniformInt(0, 1919) << ' ' << random.uniformInt(0, 1079) << ' '
+                         << random.uniformInt(1, 10) << (k % 2 ? " 8 16" : "") << '\n';
+            }
+            unsigned long long checksums[2] = {};
+            for (int run = 0; run < 2; run++)
+            {
+                istringstream in(schedule.str());
+                unique_ptr<ScriptedInput> script(new ScriptedInput());
+                string error;
+                script->load(in, error);
+                Engine engine(Vector2u(1920, 1080));
+                engine.setInput(move(script));
+                Benchmark::Clock::time_point start = Benchmark::Clock::now();
+                int frames = 0;
+                for (; !engine.getInput()->finished(); frames++)
+                {
+                    engine.step(kDt);
+                }
+                const double seconds = Benchmark::secondsSince(start);
+                checksums[run] = engine.getChecksum();
+                if (run == 1)
+                {
+                    cout << left << setw(24) << "scripted" << frames / seconds << " frames/s, " << frames << " frames, "
+                         << engine.getParticleCount() << " live, second run "
+                         << (checksums[0] == checksums[1] ? "same" : "differs") << endl;
+                }
+            }
+        }
+    }
+
+    // Settings for the end-to-end scenarios, from the command line
+    struct ScenarioOptions
+    {
+        unsigned threads;
+        unsigned seed;
+        bool render;
+        size_t reserve;
+        ShapeSource shapes;
+        bool profile;
+    };
+    ScenarioOptions scenarioOptions = { 1, 1, false, 0, ShapeSource::Tables, false };
+
+    // Run a headless engine for frames fixed timesteps, calling spawner before
+    // each one, and print the results as one JSON object on a line.
+    // spawner gets its own generator from the run seed for picking positions.
+    void runScenario(const char* name, int frames, const function<void(Engine&, Random&, int)>& spawner)
+    {
+        Engine engine(Vector2u(1920, 1080));
+        engine.seed(scenarioOptions.seed);
+        Random random(scenarioOptions.seed, 2);
+        engine.setUpdateThreads(scenarioOptions.threads);
+        EmitterConfig emitter;
+        emitter.shapes = scenarioOptions.shapes;
+        engine.setEmitter(emitter);
+        engine.setProfiling(scenarioOptions.profile);
+        if (scenarioOptions.reserve > 0)
+        {
+            engine.reserve(scenarioOptions.reserve);
+        }
+
+        vector<double> frameMs;
+        frameMs.reserve(frames);
+        double updates = 0.0;
+        double totalSeconds = 0.0;
+        size_t peak = 0;
+        size_t allocations = 0;
+        size_t lateAllocations = 0; // In the second half of the run, once the load is steady
+        for (int f = 0; f < frames; f++)
+        {
+            size_t allocationsBefore = Benchmark::allocationCount();
+            Benchmark::Clock::time_point start = Benchmark::Clock::now();
+            spawner(engine, random, f);
+            updates += engine.getParticleCount();
+            peak = max(peak, engine.getParticleCount());
+            engine.step(kDt, scenarioOptions.render);
+            double seconds = Benchmark::secondsSince(start);
+            size_t frameAllocations = Benchmark::allocationCount() - allocationsBefore;
+            allocations += frameAllocations;
+            if (f >= frames / 2)
+            {
+                lateAllocations += frameAllocations;
+            }
+            totalSeconds += seconds;
+            frameMs.push_back(seconds * 1e3);
+        }
+
+        double p50 = Benchmark::percentile(frameMs, 50);
+        double p99 = Benchmark::percentile(frameMs, 99);
+        cout << fixed << setprecision(4)
+             << "{\"scenario\": \"" << name << "\""
+             << ", \"frames\": " << frames
+             << ", \"dt\": " << setprecision(6) << kDt << setprecision(4)
+             << ", \"threads\": " << scenarioOptions.threads
+             << ", \"seed\": " << scenarioOptions.seed
+             << ", \"render\": " << (scenarioOptions.render ? "true" : "false")
+             << ", \"reserve\": " << scenarioOptions.reserve
+             << ", \"shapes\": \"" << shapeSourceName(scenarioOptions.shapes) << "\""
+             << ", \"peak_particles\": " << peak
+             << ", \"particle_updates\": " << setprecision(0) << updates
+             << ", \"particles_per_sec\": " << updates / totalSeconds
+             << setprecision(3)
+             << ", \"ns_per_particle_update\": " << (updates > 0 ? totalSeconds * 1e9 / updates : 0.0)
+             << setprecision(4)
+             << ", \"frame_ms_p50\": " << p50
+             << ", \"frame_ms_p99\": " << p99
+             << ", \"frame_ms_max\": " << frameMs.back()
+             << ", \"allocations\": " << allocations
+             << ", \"allocations_second_half\": " << lateAllocations
+             << "}" << endl;
+        if (scenarioOptions.profile)
+        {
+            engine.getProfiler().writeJson(cout, frames);
+        }
+    }
+
+    // A held mouse button: 5 particles per frame at one spot
+    void scenarioSteady()
+    {
+        runScenario("steady", 1200, [](Engine& engine, Random&, int) {
+            engine.spawn(Vector2i(960, 540), 5);
+        });
+    }
+
+    // Bursts of 2000 particles at random spots twice a second
+    void scenarioBurst()
+    {
+        runScenario("burst", 1200, [](Engine& engine, Random& random, int frame) {
+            if (frame % 30 == 0)
+            {
+                engine.spawn(Vector2i(random.uniformInt(0, 1919), random.uniformInt(0, 1079)), 2000);
+            }
+        });
+    }
+
+    // Ramp up to 100k live particles and keep topping the count back up
+    void scenarioMaxLive()
+    {
+        runScenario("max-live", 600, [](Engine& engine, Random& random, int) {
+            const int target = 100000;
+            int missing = target - static_cast<int>(engine.getParticleCount());
+            engine.spawn(Vector2i(random.uniformInt(0, 1919), random.uniformInt(0, 1079)), min(missing, 2500));
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Options for the scenarios:
+    //   --threads N  update particles on N threads (0 = one per core)
+    //   --seed S     random seed for spawning
+    //   --render     also generate the draw vertices every frame
+    //   --reserve N  preallocate the engine for N live particles
+    //   --shapes S   shape source: generated, tables (default) or prebuilt
+    //   --profile    follow each scenario's line with its per-phase timings
+    vector<string> names;
+    for (int a = 1; a < argc; a++)
+    {
+        string arg = argv[a];
+        if (arg == "--threads" && a + 1 < argc)
+        {
+            scenarioOptions.threads = static_cast<unsigned>(strtoul(argv[++a], nullptr, 10));
+        }
+        else if (arg == "--seed" && a + 1 < argc)
+        {
+            scenarioOptions.seed = static_cast<unsigned>(strtoul(argv[++a], nullptr, 10));
+        }
+        else if (arg == "--reserve" && a + 1 < argc)
+        {
+            scenarioOptions.reserve = strtoul(argv[++a], nullptr, 10);
+        }
+        else if (arg == "--shapes" && a + 1 < argc)
+        {
+            if (!parseShapeSource(argv[++a], scenarioOptions.shapes))
+            {
+                cerr << "Unknown shape source " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--profile")
+        {
+            scenarioOptions.profile = true;
+        }
+        else if (arg == "--render")
+        {
+            scenarioOptions.render = true;
+        }
+        else
+        {
+            names.push_back(arg);
+        }
+    }
+
+    // Run every benchmark, or only the ones named on the command line
+    struct Entry { const char* name; void (*run)(); };
+    const Entry entries[] = {
+        { "transform", benchTransform },
+        { "kernels", benchKernels },
+        { "threads", benchThreads },
+        { "expiry", benchExpiry },
+        { "grid", benchGrid },
+        { "culling", benchCulling },
+        { "lod", benchLod },
+        { "spawn", benchSpawn },
+        { "profiler", benchProfiler },
+        { "timestep", benchTimestep },
+        { "replay", benchReplay },
+        { "raster", benchRaster },
+        { "input", benchInput },
+        { "budget", benchBudget },
+        { "steady", scenarioSteady },
+        { "burst", scenarioBurst },
+        { "max-live", scenarioMaxLive },
+    };
+
+    for (const Entry& entry : entries)
+    {
+        if (names.empty() || find(names.begin(), names.end(), entry.name) != names.end())
+        {
+            entry.run();
+        }
+    }
+    return 0;
+}
@@ -1,19 +1,309 @@
 #include "Engine.h"
-#include "Particle.h"
+#include "FrameExporter.h"
+#include "InputSource.h"
+#include "Replay.h"
+#include "SoftwareRasterizer.h"
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
 
-int main()
+namespace
 {
+    // Every option main takes, each followed by its value (see main)
+    const char* const kOptions[] = { "--threads", "--seed", "--reserve", "--shapes", "--collisions", "--retire-offscreen",
+                                     "--lod-pixels", "--input", "--timestep", "--tick-rate", "--budget", "--profile",
+                                     "--record", "--replay", "--export" };
+
+    bool isOption(const std::string& name)
+    {
+        for (const char* option : kOptions)
+        {
+            if (name == option)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The input source named by --input: "mouse", "-" for a command feed on
+    // standard input, unix:PATH for one on a UNIX socket, or a schedule file.
+    // Null, once the reason is printed, if it cannot be opened.
+    std::unique_ptr<InputSource> openInput(Engine& engine, const std::string& name)
+    {
+        std::string error;
+        if (name == "mouse")
+        {
+            return std::unique_ptr<InputSource>(new MouseInput(engine.getWindow()));
+        }
+        if (name == "-" || name.compare(0, 5, "unix:") == 0)
+        {
+            StreamInput* stream = new StreamInput();
+            std::unique_ptr<InputSource> input(stream);
+            if (name == "-" ? !stream->openStdin() : !stream->listen(name.substr(5), error))
+            {
+                std::cerr << "Cannot read commands from " << name << (error.empty() ? "" : ": ") << error << std::endl;
+                return nullptr;
+            }
+            return input;
+        }
+        ScriptedInput* script = new ScriptedInput();
+        std::unique_ptr<InputSource> input(script);
+        if (!script->load(name, error))
+        {
+            std::cerr << name << ": " << error << std::endl;
+            return nullptr;
+        }
+        return input;
+    }
+
+    // Play a recording headless, checking it against its checksums, and
+    // report. With an export pattern every frame is also rendered in software
+    // and written out (see FrameExporter).
+    int replay(const std::string& path, unsigned threads, const std::string& exportPattern)
+    {
+        // Raw frames on standard output leave only standard error for the report
+        std::ostream& log = exportPattern == "-" ? std::cerr : std::cout;
+        RecordingReader recording;
+        std::string error;
+        if (!recording.open(path, error))
+        {
+            std::cerr << path << ": " << error << std::endl;
+            return 1;
+        }
+        const RecordingHeader& header = recording.header();
+        Engine engine(Vector2u(header.width, header.height));
+        engine.setUpdateThreads(threads);
+        Replay player(recording);
+        if (!player.start(engine))
+        {
+            std::cerr << path << ": damaged snapshot of frame 0" << std::endl;
+            return 1;
+        }
+
+        SoftwareRasterizer rasterizer;
+        FrameExporter exporter;
+        std::function<void(float)> render;
+        if (!exportPattern.empty())
+        {
+            if (!exporter.open(exportPattern))
+            {
+                std::cerr << "Cannot export to " << exportPattern << std::endl;
+                return 1;
+            }
+            render = [&](float alpha) {
+                engine.rasterize(rasterizer, alpha);
+                exporter.write(rasterizer.getPixels(), rasterizer.getWidth(), rasterizer.getHeight());
+            };
+        }
+        Replay::Report report = player.play(engine, recording.frameCount(), true, render);
+        exporter.close();
+        log << path << ": " << report.frames << " frames" << (recording.truncated() ? " (cut short)" : "") << " in "
+                  << report.seconds << " s, " << report.checks << " checks, " << report.mismatches << " mismatches";
+        if (report.mismatches > 0)
+        {
+            log << ", first at frame " << report.firstMismatch;
+        }
+        if (!exportPattern.empty())
+        {
+            log << ", " << exporter.frames() << " frames of " << header.width << "x" << header.height << " exported";
+        }
+        log << std::endl;
+        return report.mismatches > 0 ? 2 : 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // --replay FILE plays a recording without a window instead of running.
+    // Every option is checked here, known and given a value, for both modes.
+    unsigned threads = 1;
+    std::string replayPath;
+    std::string exportPattern;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (!isOption(option))
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+        if (i + 1 == argc || argv[i + 1][0] == '\0')
+        {
+            std::cerr << option << " needs a value" << std::endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (option == "--threads")
+        {
+            threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        }
+        else if (option == "--replay")
+        {
+            replayPath = value;
+        }
+        else if (option == "--export")
+        {
+            exportPattern = value;
+        }
+    }
+    if (!replayPath.empty())
+    {
+        return replay(replayPath, threads, exportPattern);
+    }
+    if (!exportPattern.empty())
+    {
+        std::cerr << "--export needs --replay" << std::endl;
+        return 1;
+    }
+
     // Create an Engine instance.
     Engine engine;
 
-    // Create a Particle for unit testing.
-    // The tests are provided to check your code.
-    std::cout << "Starting Particle unit tests..." << std::endl;
-    Particle p(engine.getWindow(), 4, Vector2i(engine.getWindow().getSize().x / 2, engine.getWindow().getSize().y / 2));
-    p.unitTests();
-    std::cout << "Unit tests complete. Starting engine..." << std::endl;
+    // Optional settings:
+    //   --threads N  update particles on N threads (0 = one per core)
+    //   --seed S     fix the random seed so runs can be reproduced
+    //   --reserve N  preallocate for N live particles, the expected peak
+    //   --shapes S   where particle shapes come from: generated, tables or prebuilt
+    //   --collisions on|off  let particles bounce off each other (off)
+    //   --retire-offscreen on|off  drop particles that fell out of view for good (on)
+    //   --lod-pixels P  merge outline edges shorter than P pixels (4; 0 = off)
+    //   --input I    where spawns come from: mouse (default), a schedule file
+    //                of "time x y count [minPoints maxPoints]" lines, or a live
+    //                feed of "x y count [minPoints maxPoints]" lines on standard
+    //                input (-) or a UNIX socket (unix:PATH)
+    //   --timestep M variable (default), fixed or threaded: fixed steps at
+    //                --tick-rate per second, on a simulation thread if threaded
+    //   --tick-rate R fixed steps per second (120)
+    //   --budget MS  hold frames to MS milliseconds of work by throttling
+    //                spawns, simplifying shapes and retiring the oldest
+    //                particles as needed (0 = off, the default; F3 shows it)
+    //   --profile F  record frame timings and write them to F every 600 frames,
+    //                as CSV, or as JSON lines if F ends in .json (F3 shows them)
+    //   --record F   record the session to F, for --replay F to play back
+    //                and verify (not with the threaded timestep)
+    //   --replay F   play back and verify recording F without a window, then exit
+    //   --export P   with --replay, render every frame in software to P:
+    //                frames/%05d.png or .ppm, a raw RGBA file or pipe, or - for stdout
+    Timestep timestep = Timestep::Variable;
+    unsigned tickRate = 120;
+    std::string recordPath;
+    for (int i = 1; i < argc; i++)
+    {
+        // Known and with a value, as checked above
+        const std::string option = argv[i];
+        const char* arg = argv[++i];
+        unsigned value = static_cast<unsigned>(std::strtoul(arg, nullptr, 10));
+        if (option == "--threads")
+        {
+            engine.setUpdateThreads(value);
+        }
+        else if (option == "--seed")
+        {
+            engine.seed(value);
+        }
+        else if (option == "--reserve")
+        {
+            engine.reserve(value);
+        }
+        else if (option == "--collisions")
+        {
+            CollisionConfig collisions = engine.getCollisions();
+            collisions.enabled = std::string(arg) == "on";
+            engine.setCollisions(collisions);
+        }
+        else if (option == "--retire-offscreen")
+        {
+            engine.setRetireOffscreen(std::string(arg) != "off");
+        }
+        else if (option == "--lod-pixels")
+        {
+            LodConfig lod = engine.getLod();
+            lod.pixelsPerEdge = static_cast<float>(std::atof(arg));
+            lod.enabled = lod.pixelsPerEdge > 0.0f;
+            engine.setLod(lod);
+        }
+        else if (option == "--timestep")
+        {
+            std::string mode = arg;
+            if (mode == "variable")
+            {
+                timestep = Timestep::Variable;
+            }
+            else if (mode == "fixed")
+            {
+                timestep = Timestep::Fixed;
+            }
+            else if (mode == "threaded")
+            {
+                timestep = Timestep::Threaded;
+            }
+            else
+            {
+                std::cerr << "Unknown timestep " << mode << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--tick-rate")
+        {
+            tickRate = value > 0 ? value : tickRate;
+        }
+        else if (option == "--budget")
+        {
+            BudgetConfig budget;
+            budget.targetMs = std::atof(arg);
+            budget.enabled = budget.targetMs > 0.0;
+            engine.setBudget(budget);
+        }
+        else if (option == "--profile")
+        {
+            if (!engine.setProfileExport(arg))
+            {
+                std::cerr << "Cannot write " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--input")
+        {
+            std::unique_ptr<InputSource> input = openInput(engine, arg);
+            if (!input)
+            {
+                return 1;
+            }
+            engine.setInput(std::move(input));
+        }
+        else if (option == "--record")
+        {
+            recordPath = arg;
+        }
+        else if (option == "--shapes")
+        {
+            EmitterConfig emitter = engine.getEmitter();
+            if (!parseShapeSource(arg, emitter.shapes))
+            {
+                std::cerr << "Unknown shape source " << arg << std::endl;
+                return 1;
+            }
+            engine.setEmitter(emitter);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    engine.setTimestep(timestep, tickRate);
+
+    // After every setting, since the recording starts with them
+    if (!recordPath.empty() && !engine.startRecording(recordPath))
+    {
+        std::cerr << "Cannot record to " << recordPath << (timestep == Timestep::Threaded ? " with the threaded timestep" : "")
+                  << std::endl;
+        return 1;
+    }
 
-    // Run the engine (start the game loop).
+    // Run the engine (start the game loop). It runs the Particle unit tests first.
     engine.run();
 
     // The program exits here when the engine stops.
@@ -0,0 +1,336 @@
+#include "Benchmark.h"
+#include "Matrices.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace Matrices;
+
+// Microbenchmarks of the Matrices library on the shapes the particles use:
+// 2x2 times 2xN and 2xN plus 2xN for N = 4 to 50, over batches of distinct
+// matrices from one that stays in registers to ones that spill out of L2.
+// Every case reports ns, allocations and bytes allocated per operation, and
+// can be saved as a baseline to compare a later build against.
+namespace
+{
+    const int kColumns[] = { 4, 8, 16, 25, 32, 50 };
+    const int kBatches[] = { 1, 64, 4096 };
+    const int kMinOpsPerCall = 4096;  // Keeps the clock out of the timings of small batches
+
+    struct Result
+    {
+        double ns = 0.0;
+        double allocations = 0.0;
+        double bytes = 0.0;
+    };
+
+    struct Options
+    {
+        string filter;                // Run only cases whose name contains this
+        string baselinePath;          // Compare against this baseline
+        string savePath;              // Save the results as a baseline
+        double minSeconds = 0.1;      // Per timing
+        int repeats = 3;              // Timings per case; the median is reported
+        double threshold = 10.0;      // Percent slower that counts as a regression
+    };
+
+    Options options;
+    map<string, Result> baseline;
+    vector<pair<string, Result>> results;
+    int slower = 0;
+    int faster = 0;
+
+    // A 2xn matrix of vertex-like coordinates
+    Matrix randomShape(int n, Random& random)
+    {
+        Matrix m(2, n);
+        for (int j = 0; j < n; j++)
+        {
+            m(0, j) = random.uniform(-500.0f, 500.0f);
+            m(1, j) = random.uniform(-500.0f, 500.0f);
+        }
+        return m;
+    }
+
+    // Time body, which performs ops operations, and print and keep the result
+    void run(const string& name, int ops, const function<void()>& body)
+    {
+        if (name.find(options.filter) == string::npos)
+        {
+            return;
+        }
+
+        // Allocations are exact, so one call after warming up tells them
+        body();
+        const size_t allocationsBefore = Benchmark::allocationCount();
+        const size_t bytesBefore = Benchmark::allocatedBytes();
+        body();
+        Result result;
+        result.allocations = static_cast<double>(Benchmark::allocationCount() - allocationsBefore) / ops;
+        result.bytes = static_cast<double>(Benchmark::allocatedBytes() - bytesBefore) / ops;
+
+        vector<double> samples;
+        for (int r = 0; r < options.repeats; r++)
+        {
+            samples.push_back(Benchmark::nsPerCall(body, options.minSeconds) / ops);
+        }
+        result.ns = Benchmark::percentile(samples, 50);
+        results.push_back(make_pair(name, result));
+
+        cout << left << setw(34) << name << right << fixed << setprecision(2) << setw(10) << result.ns << " ns/op"
+             << setprecision(1) << setw(8) << result.allocations << " allocs/op" << setprecision(0) << setw(8) << result.bytes
+             << " B/op";
+        map<string, Result>::const_iterator before = baseline.find(name);
+        if (before != baseline.end())
+        {
+            // Timings are noisy, allocations are not: any new allocation counts
+            const double change = (result.ns / before->second.ns - 1.0) * 100.0;
+            const bool moreAllocations = result.allocations > before->second.allocations || result.bytes > before->second.bytes;
+            cout << setprecision(1) << setw(9) << showpos << change << "%" << noshowpos;
+            if (change > options.threshold || moreAllocations)
+            {
+                cout << (moreAllocations ? "  SLOWER, MORE ALLOCATIONS" : "  SLOWER");
+                slower++;
+            }
+            else if (change < -options.threshold)
+            {
+                cout << "  faster";
+                faster++;
+            }
+        }
+        cout << endl;
+    }
+
+    // Repeat a pass over a batch of batch matrices often enough to time it
+    int repeatsFor(int batch)
+    {
+        return max(1, kMinOpsPerCall / batch);
+    }
+
+    void benchBinary(int n, int batch)
+    {
+        Random random(static_cast<uint64_t>(n * 10007 + batch));
+        const RotationMatrix R(0.3);
+        vector<Matrix> a;
+        vector<Matrix> b;
+        vector<Matrix> out;
+        for (int k = 0; k < batch; k++)
+        {
+            a.push_back(randomShape(n, random));
+            b.push_back(randomShape(n, random));
+            out.push_back(Matrix(2, n));
+        }
+        const int passes = repeatsFor(batch);
+        const int ops = passes * batch;
+        ostringstream shape;
+        shape << "2x" << n << "/" << batch;
+
+        run("multiply/2x2*" + shape.str(), ops, [&] {
+            for (int p = 0; p < passes; p++)
+            {
+                for (int k = 0; k < batch; k++)
+                {
+                    Matrix c = R * a[k];
+                    Benchmark::doNotOptimize(c(1, n - 1));
+                }
+            }
+        });
+        run("multiplyInto/2x2*" + shape.str(), ops, [&] {
+            for (int p = 0; p < passes; p++)
+            {
+                for (int k = 0; k < batch; k++)
+                {
+                    multiplyInto(out[k], R, a[k]);
+                }
+            }
+            Benchmark::doNotOptimize(out);
+        });
+        run("add/" + shape.str(), ops, [&] {
+            for (int p = 0; p < passes; p++)
+            {
+                for (int k = 0; k < batch; k++)
+                {
+                    Matrix c = a[k] + b[k];
+                    Benchmark::doNotOptimize(c(1, n - 1));
+                }
+            }
+        });
+        run("addInPlace/" + shape.str(), ops, [&] {
+            for (int p = 0; p < passes; p++)
+            {
+                for (int k = 0; k < batch; k++)
+                {
+                    out[k] += b[k];
+                }
+            }
+            Benchmark::doNotOptimize(out);
+        });
+
+        // Equal matrices: every element is compared
+        vector<Matrix> copies = a;
+        run("equal/" + shape.str(), ops, [&] {
+            int equal = 0;
+            for (int p = 0; p < passes; p++)
+            {
+                for (int k = 0; k < batch; k++)
+                {
+                    equal += a[k] == copies[k];
+                }
+            }
+            Benchmark::doNotOptimize(equal);
+        });
+    }
+
+    void benchConstructors()
+    {
+        const int ops = kMinOpsPerCall;
+        run("construct/RotationMatrix", ops, [&] {
+            for (int k = 0; k < ops; k++)
+            {
+                RotationMatrix R(k * 0.001);
+                Benchmark::doNotOptimize(R(1, 0));
+            }
+        });
+        run("construct/ScalingMatrix", ops, [&] {
+            for (int k = 0; k < ops; k++)
+            {
+                ScalingMatrix S(1.0 + k * 0.001);
+                Benchmark::doNotOptimize(S(1, 1));
+            }
+        });
+        for (int n : kColumns)
+        {
+            run("construct/TranslationMatrix/2x" + to_string(n), ops, [&] {
+                for (int k = 0; k < ops; k++)
+                {
+                    TranslationMatrix T(k * 0.5, -k * 0.5, n);
+                    Benchmark::doNotOptimize(T(1, n - 1));
+                }
+            });
+        }
+    }
+
+    // A baseline is one line per case: name, ns/op, allocations/op, bytes/op
+    bool loadBaseline(const string& path)
+    {
+        ifstream in(path.c_str());
+        if (!in)
+        {
+            return false;
+        }
+        string line;
+        while (getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            istringstream fields(line);
+            string name;
+            Result result;
+            if (fields >> name >> result.ns >> result.allocations >> result.bytes && result.ns > 0.0)
+            {
+                baseline[name] = result;
+            }
+        }
+        return true;
+    }
+
+    bool saveBaseline(const string& path)
+    {
+        ofstream out(path.c_str());
+        out << "# matrices_bench baseline: name ns/op allocations/op bytes/op" << endl;
+        out << setprecision(6);
+        for (const pair<string, Result>& entry : results)
+        {
+            out << entry.first << ' ' << entry.second.ns << ' ' << entry.second.allocations << ' ' << entry.second.bytes << endl;
+        }
+        return static_cast<bool>(out);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Options:
+    //   --filter S      run only the cases whose name contains S, e.g. multiply/ or /4096
+    //   --save F        save the results to F as a baseline
+    //   --baseline F    compare every case against baseline F; exits with 2 if
+    //                   any got slower by more than the threshold or allocates more
+    //   --threshold P   percent slower that counts as a regression (10)
+    //   --min-time S    seconds per timing (0.1)
+    //   --repeats N     timings per case, of which the median is reported (3)
+    for (int a = 1; a < argc; a++)
+    {
+        string arg = argv[a];
+        if (a + 1 == argc)
+        {
+            cerr << "Missing value for " << arg << endl;
+            return 1;
+        }
+        else if (arg == "--filter")
+        {
+            options.filter = argv[++a];
+        }
+        else if (arg == "--save")
+        {
+            options.savePath = argv[++a];
+        }
+        else if (arg == "--baseline")
+        {
+            options.baselinePath = argv[++a];
+        }
+        else if (arg == "--threshold")
+        {
+            options.threshold = atof(argv[++a]);
+        }
+        else if (arg == "--min-time")
+        {
+            options.minSeconds = max(0.001, atof(argv[++a]));
+        }
+        else if (arg == "--repeats")
+        {
+            options.repeats = max(1, atoi(argv[++a]));
+        }
+        else
+        {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+    if (!options.baselinePath.empty() && !loadBaseline(options.baselinePath))
+    {
+        cerr << "Cannot read " << options.baselinePath << endl;
+        return 1;
+    }
+
+    for (int n : kColumns)
+    {
+        for (int batch : kBatches)
+        {
+            benchBinary(n, batch);
+        }
+    }
+    benchConstructors();
+
+    if (!options.savePath.empty() && !saveBaseline(options.savePath))
+    {
+        cerr << "Cannot write " << options.savePath << endl;
+        return 1;
+    }
+    if (!options.baselinePath.empty())
+    {
+        cout << slower << " slower, " << faster << " faster than " << options.baselinePath << " (threshold "
+             << setprecision(1) << options.threshold << "%)" << endl;
+        return slower > 0 ? 2 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Tests.h"
+#include <cstring>
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        bool (*run)();
+    };
+
+    const TestCase kTests[] = {
+        { "Random streams", testRandomStreams },
+        { "vertex kernels against the Matrices path", testVertexKernels },
+        { "float32 precision against double", testFloatPrecision },
+        { "shapes from direction tables and the prebuilt pool", testShapes },
+        { "pooled spawning and vertex recycling", testPooledSpawning },
+        { "posed local shapes against Particle::update", testPosedShapes },
+        { "interpolated drawing and state copies", testInterpolation },
+        { "viewport culling and off-screen retirement", testCulling },
+        { "level-of-detail vertex subsets", testLevelOfDetail },
+        { "particle state save and restore", testSaveRestore },
+        { "the same state on 1 and 3 threads", testThreadCountDeterminism },
+        { "recording, reading back and replaying", testRecordingRoundTrip },
+        { "a recording cut short", testRecordingCutShort },
+        { "spatial grid queries and collisions", testSpatialGrid },
+        { "the software rasterizer", testSoftwareRasterizer },
+        { "scripted and streamed input", testInput },
+        { "the frame-time budget controller", testFrameBudget },
+    };
+}
+
+// Runs the module tests, or with arguments only those whose name contains
+// one of them, e.g. particles_tests grid budget. Exits 1 if any failed.
+int main(int argc, char* argv[])
+{
+    int run = 0;
+    int passed = 0;
+    for (const TestCase& test : kTests)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++)
+        {
+            selected = strstr(test.name, argv[i]) != nullptr;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        cout << "Testing " << test.name << "..." << endl;
+        run++;
+        if (test.run())
+        {
+            cout << "Passed." << endl;
+            passed++;
+        }
+        else
+        {
+            cout << "Failed." << endl;
+        }
+    }
+    cout << "Passed " << passed << " / " << run << endl;
+    return passed == run ? 0 : 1;
+}